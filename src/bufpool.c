@@ -0,0 +1,265 @@
+#include "bufpool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Classes de 2^12 + 2^10 octets à 2^34 octets
+#define MIN_SHIFT 12
+#define MAX_SHIFT 34
+#define NB_CLASSES (4 * (MAX_SHIFT - MIN_SHIFT))
+#define NO_CLASS (-1)
+
+// En-tête placé juste avant chaque tampon; il garde l'alignement du tampon
+union bufpool_header {
+  struct {
+    int cls;
+    size_t size;                 // taille allouée, en-tête compris
+    union bufpool_header* next;  // dans une liste de tampons libres
+  };
+  char pad[BUFPOOL_ALIGN];
+};
+
+struct bufpool_cache {
+  union bufpool_header* bufs[NB_CLASSES][BUFPOOL_THREAD_CACHE];
+  int nb[NB_CLASSES];
+  // Pris par le thread propriétaire, disputé seulement par bufpool_trim()
+  pthread_mutex_t lock;
+  struct bufpool_cache* next;  // dans la liste des caches des threads
+};
+
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static union bufpool_header* shared[NB_CLASSES];
+
+// Caches des threads vivants, pour que bufpool_trim() les vide tous
+static pthread_mutex_t caches_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct bufpool_cache* caches;
+
+static size_t limit = BUFPOOL_DEFAULT_LIMIT;
+static size_t cached_bytes;
+static struct bufpool_stats counters;
+
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+static __thread struct bufpool_cache* local_cache;
+
+// Taille de la classe cls: (5..8) * 2^(k-2), quatre classes par puissance de 2
+static inline size_t class_size(int cls) {
+  return (size_t)(5 + cls % 4) << (cls / 4 + MIN_SHIFT - 2);
+}
+
+// Plus petite classe qui contient size octets
+static inline int size_class(size_t size) {
+  if (size <= BUFPOOL_MIN_SIZE) {
+    return NO_CLASS;
+  }
+  int shift = 63 - __builtin_clzll(size - 1);
+  int cls = (shift - MIN_SHIFT) * 4 + (int)((size - 1) >> (shift - 2)) - 4;
+  return cls < NB_CLASSES ? cls : NO_CLASS;
+}
+
+static inline void count(uint64_t* counter) {
+  __atomic_add_fetch(counter, 1, __ATOMIC_RELAXED);
+}
+
+// Réserver n octets de la limite; retourne 0 si la réserve est pleine
+static int cache_reserve(size_t n) {
+  size_t cur = __atomic_load_n(&cached_bytes, __ATOMIC_RELAXED);
+  do {
+    if (cur + n > __atomic_load_n(&limit, __ATOMIC_RELAXED)) {
+      return 0;
+    }
+  } while (!__atomic_compare_exchange_n(&cached_bytes, &cur, cur + n, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  return 1;
+}
+
+static void shared_push(union bufpool_header* h) {
+  pthread_mutex_lock(&shared_lock);
+  h->next = shared[h->cls];
+  shared[h->cls] = h;
+  pthread_mutex_unlock(&shared_lock);
+}
+
+// Verser le cache d'un thread dans la réserve commune
+static void cache_drain(struct bufpool_cache* cache) {
+  for (int cls = 0; cls < NB_CLASSES; cls++) {
+    while (cache->nb[cls] > 0) {
+      shared_push(cache->bufs[cls][--cache->nb[cls]]);
+    }
+  }
+}
+
+// Rendre au système les tampons d'un cache; cache->lock doit être tenu
+static void cache_release(struct bufpool_cache* cache) {
+  for (int cls = 0; cls < NB_CLASSES; cls++) {
+    while (cache->nb[cls] > 0) {
+      union bufpool_header* h = cache->bufs[cls][--cache->nb[cls]];
+      __atomic_sub_fetch(&cached_bytes, h->size, __ATOMIC_RELAXED);
+      free(h);
+    }
+  }
+}
+
+// Destructeur de la clé: le thread se termine
+static void cache_flush(void* arg) {
+  struct bufpool_cache* cache = arg;
+  pthread_mutex_lock(&caches_lock);
+  struct bufpool_cache** p = &caches;
+  while (*p != cache) {
+    p = &(*p)->next;
+  }
+  *p = cache->next;
+  pthread_mutex_unlock(&caches_lock);
+
+  cache_drain(cache);
+  pthread_mutex_destroy(&cache->lock);
+  free(cache);
+  local_cache = NULL;
+}
+
+static void cache_key_init(void) {
+  pthread_key_create(&cache_key, cache_flush);
+}
+
+static struct bufpool_cache* thread_cache(void) {
+  if (local_cache) {
+    return local_cache;
+  }
+  pthread_once(&cache_once, cache_key_init);
+  struct bufpool_cache* cache = calloc(1, sizeof(struct bufpool_cache));
+  if (!cache) {
+    return NULL;
+  }
+  pthread_mutex_init(&cache->lock, NULL);
+  pthread_mutex_lock(&caches_lock);
+  cache->next = caches;
+  caches = cache;
+  pthread_mutex_unlock(&caches_lock);
+  pthread_setspecific(cache_key, cache);
+  local_cache = cache;
+  return cache;
+}
+
+void* bufpool_alloc(size_t size) {
+  count(&counters.allocs);
+  int cls = size_class(size);
+  union bufpool_header* h = NULL;
+
+  if (cls != NO_CLASS) {
+    struct bufpool_cache* cache = thread_cache();
+    if (cache) {
+      pthread_mutex_lock(&cache->lock);
+      if (cache->nb[cls] > 0) {
+        h = cache->bufs[cls][--cache->nb[cls]];
+      }
+      pthread_mutex_unlock(&cache->lock);
+    }
+    if (h) {
+      count(&counters.thread_hits);
+    } else {
+      pthread_mutex_lock(&shared_lock);
+      h = shared[cls];
+      if (h) {
+        shared[cls] = h->next;
+      }
+      pthread_mutex_unlock(&shared_lock);
+      if (h) {
+        count(&counters.shared_hits);
+      }
+    }
+    if (h) {
+      __atomic_sub_fetch(&cached_bytes, h->size, __ATOMIC_RELAXED);
+      return h + 1;
+    }
+  }
+
+  size_t total = sizeof(union bufpool_header) +
+                 (cls != NO_CLASS ? class_size(cls) : size);
+  total = (total + BUFPOOL_ALIGN - 1) & ~(size_t)(BUFPOOL_ALIGN - 1);
+  h = aligned_alloc(BUFPOOL_ALIGN, total);
+  if (!h) {
+    return NULL;
+  }
+  count(&counters.misses);
+  h->cls = cls;
+  h->size = total;
+  return h + 1;
+}
+
+void bufpool_free(void* buf) {
+  if (!buf) {
+    return;
+  }
+  union bufpool_header* h = (union bufpool_header*)buf - 1;
+  if (h->cls == NO_CLASS || !cache_reserve(h->size)) {
+    if (h->cls != NO_CLASS) {
+      count(&counters.released);
+    }
+    free(h);
+    return;
+  }
+
+  struct bufpool_cache* cache = thread_cache();
+  if (cache) {
+    pthread_mutex_lock(&cache->lock);
+    int kept = cache->nb[h->cls] < BUFPOOL_THREAD_CACHE;
+    if (kept) {
+      cache->bufs[h->cls][cache->nb[h->cls]++] = h;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    if (kept) {
+      return;
+    }
+  }
+  shared_push(h);
+}
+
+void bufpool_set_limit(size_t bytes) {
+  __atomic_store_n(&limit, bytes, __ATOMIC_RELAXED);
+  if (__atomic_load_n(&cached_bytes, __ATOMIC_RELAXED) > bytes) {
+    bufpool_trim();
+  }
+}
+
+void bufpool_trim(void) {
+  pthread_mutex_lock(&caches_lock);
+  for (struct bufpool_cache* cache = caches; cache; cache = cache->next) {
+    pthread_mutex_lock(&cache->lock);
+    cache_release(cache);
+    pthread_mutex_unlock(&cache->lock);
+  }
+  pthread_mutex_unlock(&caches_lock);
+
+  pthread_mutex_lock(&shared_lock);
+  for (int cls = 0; cls < NB_CLASSES; cls++) {
+    while (shared[cls]) {
+      union bufpool_header* h = shared[cls];
+      shared[cls] = h->next;
+      __atomic_sub_fetch(&cached_bytes, h->size, __ATOMIC_RELAXED);
+      free(h);
+    }
+  }
+  pthread_mutex_unlock(&shared_lock);
+}
+
+void bufpool_get_stats(struct bufpool_stats* stats) {
+  stats->allocs = __atomic_load_n(&counters.allocs, __ATOMIC_RELAXED);
+  stats->thread_hits = __atomic_load_n(&counters.thread_hits, __ATOMIC_RELAXED);
+  stats->shared_hits = __atomic_load_n(&counters.shared_hits, __ATOMIC_RELAXED);
+  stats->misses = __atomic_load_n(&counters.misses, __ATOMIC_RELAXED);
+  stats->released = __atomic_load_n(&counters.released, __ATOMIC_RELAXED);
+  stats->cached_bytes = __atomic_load_n(&cached_bytes, __ATOMIC_RELAXED);
+}
+
+void bufpool_stats_print(FILE* out) {
+  struct bufpool_stats s;
+  bufpool_get_stats(&s);
+  uint64_t hits = s.thread_hits + s.shared_hits;
+  fprintf(out,
+          "buffers: %lu allocs, %.1f%% hits (%lu thread, %lu shared), "
+          "%lu released, %.1f MiB cached\n",
+          (unsigned long)s.allocs, s.allocs ? 100.0 * hits / s.allocs : 0.0,
+          (unsigned long)s.thread_hits, (unsigned long)s.shared_hits,
+          (unsigned long)s.released, s.cached_bytes / (1024.0 * 1024.0));
+}
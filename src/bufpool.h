@@ -0,0 +1,61 @@
+#ifndef INF3170_BUFPOOL_H_
+#define INF3170_BUFPOOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Réserve de tampons de pixels alignés sur BUFPOOL_ALIGN.
+ *
+ * Chaque filtre alloue une nouvelle image et libère la précédente: sans
+ * réserve, chaque gros tampon est un mmap, des défauts de page et une mise à
+ * zéro par le noyau. Les tampons libérés sont gardés par classe de taille,
+ * quatre classes par puissance de deux (au plus 25% de perte), d'abord dans
+ * un petit cache du thread, dont le verrou n'est disputé que par
+ * bufpool_trim(), puis dans une réserve commune. Les tampons plus petits que
+ * BUFPOOL_MIN_SIZE ou plus grands que la dernière classe vont directement au
+ * système.
+ *
+ * La réserve et les caches des threads gardent ensemble au plus
+ * bufpool_set_limit() octets; au-delà, les tampons libérés sont rendus au
+ * système. Le cache d'un thread qui se termine est versé dans la réserve
+ * commune. Un tampon recyclé n'est pas remis à zéro.
+ */
+
+#define BUFPOOL_ALIGN 64
+#define BUFPOOL_MIN_SIZE 4096
+#define BUFPOOL_THREAD_CACHE 2  // tampons par classe dans le cache d'un thread
+#define BUFPOOL_DEFAULT_LIMIT ((size_t)512 << 20)
+
+struct bufpool_stats {
+  uint64_t allocs;
+  uint64_t thread_hits;  // servis par le cache du thread
+  uint64_t shared_hits;  // servis par la réserve commune
+  uint64_t misses;       // alloués au système
+  uint64_t released;     // rendus au système parce que la réserve est pleine
+  size_t cached_bytes;   // octets gardés en réserve
+};
+
+// Tampon d'au moins size octets, NULL si l'allocation échoue
+void *bufpool_alloc(size_t size);
+void bufpool_free(void *buf);
+
+// Octets gardés au plus en réserve; 0 rend tout au système
+void bufpool_set_limit(size_t bytes);
+// Rendre au système les tampons de la réserve commune et des caches de tous
+// les threads
+void bufpool_trim(void);
+
+void bufpool_get_stats(struct bufpool_stats *stats);
+void bufpool_stats_print(FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
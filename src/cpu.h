@@ -0,0 +1,22 @@
+#ifndef INF3170_CPU_H_
+#define INF3170_CPU_H_
+
+/*
+ * Petits utilitaires dépendants du processeur partagés par les structures
+ * concurrentes (deque, pool de threads).
+ */
+
+#define CACHELINE_SIZE 64
+#define CACHELINE_ALIGNED __attribute__((aligned(CACHELINE_SIZE)))
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#else
+  __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include "deque.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static struct deque_array* deque_array_new(int64_t size) {
+  struct deque_array* a = malloc(sizeof(*a) + size * sizeof(void*));
+  if (!a) {
+    perror("deque_array_new()");
+    return NULL;
+  }
+  a->size = size;
+  a->prev = NULL;
+  return a;
+}
+
+static inline void* deque_array_get(struct deque_array* a, int64_t i) {
+  return __atomic_load_n(&a->buf[i & (a->size - 1)], __ATOMIC_RELAXED);
+}
+
+static inline void deque_array_put(struct deque_array* a, int64_t i,
+                                   void* item) {
+  __atomic_store_n(&a->buf[i & (a->size - 1)], item, __ATOMIC_RELAXED);
+}
+
+// Doubler la capacité; l'ancien tableau reste chaîné pour les voleurs en
+// retard. Retourne NULL si l'allocation échoue, la deque est alors inchangée.
+static struct deque_array* deque_grow(struct deque* d, struct deque_array* a,
+                                      int64_t top, int64_t bottom) {
+  struct deque_array* n = deque_array_new(a->size * 2);
+  if (!n) {
+    return NULL;
+  }
+  for (int64_t i = top; i < bottom; i++) {
+    deque_array_put(n, i, deque_array_get(a, i));
+  }
+  n->prev = a;
+  __atomic_store_n(&d->array, n, __ATOMIC_RELEASE);
+  return n;
+}
+
+// La capacité est arrondie à la puissance de deux supérieure
+int deque_init(struct deque* d, int64_t capacity) {
+  int64_t size = 16;
+  while (size < capacity) {
+    size *= 2;
+  }
+  d->top = 0;
+  d->bottom = 0;
+  d->array = deque_array_new(size);
+  return d->array ? 0 : -1;
+}
+
+void deque_destroy(struct deque* d) {
+  struct deque_array* a = d->array;
+  while (a) {
+    struct deque_array* prev = a->prev;
+    free(a);
+    a = prev;
+  }
+  d->array = NULL;
+}
+
+// Propriétaire seulement; retourne -1 si la deque pleine n'a pas pu grandir
+int deque_push(struct deque* d, void* item) {
+  int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+  int64_t t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+  struct deque_array* a = __atomic_load_n(&d->array, __ATOMIC_RELAXED);
+  if (b - t > a->size - 1) {
+    a = deque_grow(d, a, t, b);
+    if (!a) {
+      return -1;
+    }
+  }
+  deque_array_put(a, b, item);
+  __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+// Propriétaire seulement; retourne NULL si la deque est vide
+void* deque_pop(struct deque* d) {
+  int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+  struct deque_array* a = __atomic_load_n(&d->array, __ATOMIC_RELAXED);
+  __atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+
+  void* item = NULL;
+  if (t <= b) {
+    item = deque_array_get(a, b);
+    if (t == b) {
+      // Dernier élément: course possible avec un voleur
+      if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST,
+                                       __ATOMIC_RELAXED)) {
+        item = NULL;
+      }
+      __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+  } else {
+    __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+  }
+  return item;
+}
+
+// N'importe quel thread; retourne NULL si vide ou si la course est perdue
+void* deque_steal(struct deque* d) {
+  int64_t t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+
+  if (t >= b) {
+    return NULL;
+  }
+
+  struct deque_array* a = __atomic_load_n(&d->array, __ATOMIC_ACQUIRE);
+  void* item = deque_array_get(a, t);
+  if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST,
+                                   __ATOMIC_RELAXED)) {
+    return NULL;
+  }
+  return item;
+}
+
+// Approximatif lorsque d'autres threads modifient la deque
+int64_t deque_size(struct deque* d) {
+  int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_SEQ_CST);
+  int64_t t = __atomic_load_n(&d->top, __ATOMIC_SEQ_CST);
+  return b > t ? b - t : 0;
+}
@@ -0,0 +1,46 @@
+#ifndef INF3170_DEQUE_H_
+#define INF3170_DEQUE_H_
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Deque de vol de tâches (Chase-Lev, version C11 de Lê et al. 2013).
+ *
+ * Le propriétaire empile et dépile par le bas sans verrou; les autres threads
+ * volent par le haut avec un CAS. Le tableau circulaire grandit au besoin; les
+ * anciens tableaux sont conservés jusqu'à deque_destroy() puisqu'un voleur peut
+ * encore les lire.
+ */
+
+struct deque_array {
+  int64_t size;
+  struct deque_array* prev;
+  void* buf[];
+};
+
+struct deque {
+  int64_t top CACHELINE_ALIGNED;
+  int64_t bottom CACHELINE_ALIGNED;
+  struct deque_array* array;
+};
+
+int deque_init(struct deque* d, int64_t capacity);
+void deque_destroy(struct deque* d);
+
+int deque_push(struct deque* d, void* item);
+void* deque_pop(struct deque* d);
+void* deque_steal(struct deque* d);
+
+int64_t deque_size(struct deque* d);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -9,6 +9,7 @@
 
 #include "filter.h"
 #include "image.h"
+#include "parallel.h"
 
 #define max(a, b) (((a) < (b)) ? (b) : (a))
 #define min(a, b) (((a) < (b)) ? (a) : (b))
@@ -118,16 +119,50 @@ done:
   hsv[2] = v;
 }
 
-image_t *filter_scale_up2(image_t *image) { return filter_scale_up(image, 2); }
+/*
+ * Every filter is written as a kernel over a band of output rows. The serial
+ * and the _mt variants run the same kernel, the latter splitting the rows
+ * across the pool, so both produce byte-identical images. The 3x3 stencils
+ * read one row above and below their band from the shared source image; bands
+ * only overlap on those read-only halo rows.
+ */
 
-image_t *filter_scale_up(image_t *image, size_t factor) {
-  image_t *new_image =
-      image_create(image->id, factor * image->width, factor * image->height);
-  if (new_image == NULL) {
-    goto fail_exit;
+struct filter_job {
+  image_t *src;
+  image_t *dst;
+  size_t factor;
+  const double (*m)[3];
+  pixel_t *add_pixel;
+  void (*rows)(struct filter_job *job, size_t y0, size_t y1);
+};
+
+static void filter_job_range(void *ctx, size_t begin, size_t end) {
+  struct filter_job *job = ctx;
+  job->rows(job, begin, end);
+}
+
+static image_t *filter_run(struct pool *pool, struct filter_job *job,
+                           size_t nb_rows) {
+  if (job->dst == NULL) {
+    return NULL;
+  }
+
+  if (pool == NULL) {
+    job->rows(job, 0, nb_rows);
+  } else {
+    threadpool_parallel_for(pool, 0, nb_rows, 0, filter_job_range, job);
   }
 
-  for (int j = 0; j < image->height; j++) {
+  return job->dst;
+}
+
+/* rows are source rows, each one writes factor rows of the new image */
+static void scale_up_rows(struct filter_job *job, size_t y0, size_t y1) {
+  image_t *image = job->src;
+  image_t *new_image = job->dst;
+  size_t factor = job->factor;
+
+  for (int j = y0; j < y1; j++) {
     for (int i = 0; i < image->width; i++) {
       pixel_t *pixel = image_get_pixel(image, i, j);
 
@@ -140,19 +175,38 @@ image_t *filter_scale_up(image_t *image, size_t factor) {
       }
     }
   }
+}
+
+static image_t *scale_up(struct pool *pool, image_t *image, size_t factor) {
+  struct filter_job job = {
+      .src = image,
+      .dst = image_create(image->id, factor * image->width,
+                          factor * image->height),
+      .factor = factor,
+      .rows = scale_up_rows,
+  };
+
+  return filter_run(pool, &job, image->height);
+}
 
-  return new_image;
+image_t *filter_scale_up2(image_t *image) { return filter_scale_up(image, 2); }
 
-fail_exit:
-  return NULL;
+image_t *filter_scale_up(image_t *image, size_t factor) {
+  return scale_up(NULL, image, factor);
 }
 
-image_t *filter_sobel(image_t *image) {
-  image_t *new_image =
-      image_create(image->id, image->width - 2, image->height - 2);
-  if (new_image == NULL) {
-    goto fail_exit;
-  }
+image_t *filter_scale_up2_mt(struct pool *pool, image_t *image) {
+  return filter_scale_up_mt(pool, image, 2);
+}
+
+image_t *filter_scale_up_mt(struct pool *pool, image_t *image, size_t factor) {
+  return scale_up(pool, image, factor);
+}
+
+/* rows are rows of the new image, row y reads source rows y to y + 2 */
+static void sobel_rows(struct filter_job *job, size_t y0, size_t y1) {
+  image_t *image = job->src;
+  image_t *new_image = job->dst;
 
   const int gx[3][3] = {
       {1, 0, -1},
@@ -166,7 +220,7 @@ image_t *filter_sobel(image_t *image) {
       {-1, -2, -1},
   };
 
-  for (int j = 1; j < image->height - 1; j++) {
+  for (int j = y0 + 1; j < y1 + 1; j++) {
     for (int i = 1; i < image->width - 1; i++) {
       int values_x[4] = {0, 0, 0, 0};
       int values_y[4] = {0, 0, 0, 0};
@@ -192,20 +246,29 @@ image_t *filter_sobel(image_t *image) {
       new_pixel->bytes[3] = pixel->bytes[3];
     }
   }
+}
 
-  return new_image;
+static image_t *sobel(struct pool *pool, image_t *image) {
+  struct filter_job job = {
+      .src = image,
+      .dst = image_create(image->id, image->width - 2, image->height - 2),
+      .rows = sobel_rows,
+  };
 
-fail_exit:
-  return NULL;
+  return filter_run(pool, &job, image->height - 2);
 }
 
-image_t *filter_to_hsv(image_t *image) {
-  image_t *new_image = image_create(image->id, image->width, image->height);
-  if (new_image == NULL) {
-    goto fail_exit;
-  }
+image_t *filter_sobel(image_t *image) { return sobel(NULL, image); }
 
-  for (int j = 0; j < image->height; j++) {
+image_t *filter_sobel_mt(struct pool *pool, image_t *image) {
+  return sobel(pool, image);
+}
+
+static void to_hsv_rows(struct filter_job *job, size_t y0, size_t y1) {
+  image_t *image = job->src;
+  image_t *new_image = job->dst;
+
+  for (int j = y0; j < y1; j++) {
     for (int i = 0; i < image->width; i++) {
       pixel_t *pixel = image_get_pixel(image, i, j);
       pixel_t *new_pixel = image_get_pixel(new_image, i, j);
@@ -214,20 +277,13 @@ image_t *filter_to_hsv(image_t *image) {
       new_pixel->bytes[3] = pixel->bytes[3];
     }
   }
-
-  return new_image;
-
-fail_exit:
-  return NULL;
 }
 
-image_t *filter_to_rgb(image_t *image) {
-  image_t *new_image = image_create(image->id, image->width, image->height);
-  if (new_image == NULL) {
-    goto fail_exit;
-  }
+static void to_rgb_rows(struct filter_job *job, size_t y0, size_t y1) {
+  image_t *image = job->src;
+  image_t *new_image = job->dst;
 
-  for (int j = 0; j < image->height; j++) {
+  for (int j = y0; j < y1; j++) {
     for (int i = 0; i < image->width; i++) {
       pixel_t *pixel = image_get_pixel(image, i, j);
       pixel_t *new_pixel = image_get_pixel(new_image, i, j);
@@ -236,20 +292,14 @@ image_t *filter_to_rgb(image_t *image) {
       new_pixel->bytes[3] = pixel->bytes[3];
     }
   }
-
-  return new_image;
-
-fail_exit:
-  return NULL;
 }
 
-image_t *filter_add_pixel(image_t *image, pixel_t *add_pixel) {
-  image_t *new_image = image_create(image->id, image->width, image->height);
-  if (new_image == NULL) {
-    goto fail_exit;
-  }
+static void add_pixel_rows(struct filter_job *job, size_t y0, size_t y1) {
+  image_t *image = job->src;
+  image_t *new_image = job->dst;
+  pixel_t *add_pixel = job->add_pixel;
 
-  for (int j = 0; j < image->height; j++) {
+  for (int j = y0; j < y1; j++) {
     for (int i = 0; i < image->width; i++) {
       pixel_t *pixel = image_get_pixel(image, i, j);
       pixel_t *new_pixel = image_get_pixel(new_image, i, j);
@@ -261,20 +311,13 @@ image_t *filter_add_pixel(image_t *image, pixel_t *add_pixel) {
       new_pixel->bytes[3] = pixel->bytes[3];
     }
   }
-
-  return new_image;
-
-fail_exit:
-  return NULL;
 }
 
-image_t *filter_desaturate(image_t *image) {
-  image_t *new_image = image_create(image->id, image->width, image->height);
-  if (new_image == NULL) {
-    goto fail_exit;
-  }
+static void desaturate_rows(struct filter_job *job, size_t y0, size_t y1) {
+  image_t *image = job->src;
+  image_t *new_image = job->dst;
 
-  for (int j = 0; j < image->height; j++) {
+  for (int j = y0; j < y1; j++) {
     for (int i = 0; i < image->width; i++) {
       pixel_t *pixel = image_get_pixel(image, i, j);
       pixel_t *new_pixel = image_get_pixel(new_image, i, j);
@@ -290,21 +333,292 @@ image_t *filter_desaturate(image_t *image) {
       new_pixel->bytes[3] = pixel->bytes[3];
     }
   }
+}
 
-  return new_image;
+static void horizontal_flip_rows(struct filter_job *job, size_t y0,
+                                 size_t y1) {
+  image_t *image = job->src;
+  image_t *new_image = job->dst;
+
+  for (int j = y0; j < y1; j++) {
+    for (int i = 0; i < image->width; i++) {
+      pixel_t *pixel = image_get_pixel(image, i, j);
+      pixel_t *new_pixel =
+          image_get_pixel(new_image, (image->width - 1) - i, j);
 
-fail_exit:
-  return NULL;
+      *new_pixel = *pixel;
+    }
+  }
 }
 
-image_t *filter_convolution33(image_t *image, const double m[3][3]) {
-  image_t *new_image =
-      image_create(image->id, image->width - 2, image->height - 2);
-  if (new_image == NULL) {
-    goto fail_exit;
+/* in place: each row swaps its two halves around the middle column */
+static void horizontal_flip_swap_rows(struct filter_job *job, size_t y0,
+                                      size_t y1) {
+  image_t *image = job->dst;
+
+  for (int j = y0; j < y1; j++) {
+    for (int i = 0; i < image->width / 2; i++) {
+      pixel_t *left = image_get_pixel(image, i, j);
+      pixel_t *right = image_get_pixel(image, (image->width - 1) - i, j);
+
+      pixel_t tmp = *left;
+      *left = *right;
+      *right = tmp;
+    }
+  }
+}
+
+static void vertical_flip_rows(struct filter_job *job, size_t y0, size_t y1) {
+  image_t *image = job->src;
+  image_t *new_image = job->dst;
+
+  for (int j = y0; j < y1; j++) {
+    for (int i = 0; i < image->width; i++) {
+      pixel_t *pixel = image_get_pixel(image, i, j);
+      pixel_t *new_pixel =
+          image_get_pixel(new_image, i, (image->height - j) - 1);
+
+      *new_pixel = *pixel;
+    }
+  }
+}
+
+/* in place: rows are rows of the top half, each one swapped with its mirror */
+static void vertical_flip_swap_rows(struct filter_job *job, size_t y0,
+                                    size_t y1) {
+  image_t *image = job->dst;
+
+  for (int j = y0; j < y1; j++) {
+    for (int i = 0; i < image->width; i++) {
+      pixel_t *top = image_get_pixel(image, i, j);
+      pixel_t *bottom = image_get_pixel(image, i, (image->height - j) - 1);
+
+      pixel_t tmp = *top;
+      *top = *bottom;
+      *bottom = tmp;
+    }
+  }
+}
+
+typedef void (*filter_rows_fn)(struct filter_job *, size_t, size_t);
+
+/*
+ * Same size filters, one row of dst per source row. The point-wise kernels
+ * read each pixel before writing it, so dst may be the source image.
+ */
+static image_t *pointwise_into(struct pool *pool, image_t *dst, image_t *image,
+                               filter_rows_fn rows, pixel_t *add_pixel) {
+  if (dst == NULL || dst->width != image->width ||
+      dst->height != image->height) {
+    return NULL;
   }
 
-  for (int j = 1; j < image->height - 1; j++) {
+  struct filter_job job = {
+      .src = image,
+      .dst = dst,
+      .add_pixel = add_pixel,
+      .rows = rows,
+  };
+
+  return filter_run(pool, &job, image->height);
+}
+
+static image_t *pointwise(struct pool *pool, image_t *image,
+                          filter_rows_fn rows, pixel_t *add_pixel) {
+  image_t *dst = image_create(image->id, image->width, image->height);
+  return pointwise_into(pool, dst, image, rows, add_pixel);
+}
+
+/* flips copy into another image, or swap pixels when dst is the source */
+static image_t *flip_into(struct pool *pool, image_t *dst, image_t *image,
+                          filter_rows_fn copy_rows, filter_rows_fn swap_rows,
+                          size_t nb_swap_rows) {
+  if (dst != image) {
+    return pointwise_into(pool, dst, image, copy_rows, NULL);
+  }
+
+  struct filter_job job = {
+      .src = image,
+      .dst = image,
+      .rows = swap_rows,
+  };
+
+  return filter_run(pool, &job, nb_swap_rows);
+}
+
+static image_t *horizontal_flip_into(struct pool *pool, image_t *dst,
+                                     image_t *image) {
+  return flip_into(pool, dst, image, horizontal_flip_rows,
+                   horizontal_flip_swap_rows, image->height);
+}
+
+static image_t *vertical_flip_into(struct pool *pool, image_t *dst,
+                                   image_t *image) {
+  return flip_into(pool, dst, image, vertical_flip_rows,
+                   vertical_flip_swap_rows, image->height / 2);
+}
+
+image_t *filter_to_hsv(image_t *image) {
+  return pointwise(NULL, image, to_hsv_rows, NULL);
+}
+
+image_t *filter_to_rgb(image_t *image) {
+  return pointwise(NULL, image, to_rgb_rows, NULL);
+}
+
+image_t *filter_add_pixel(image_t *image, pixel_t *add_pixel) {
+  return pointwise(NULL, image, add_pixel_rows, add_pixel);
+}
+
+image_t *filter_desaturate(image_t *image) {
+  return pointwise(NULL, image, desaturate_rows, NULL);
+}
+
+image_t *filter_horizontal_flip(image_t *image) {
+  return pointwise(NULL, image, horizontal_flip_rows, NULL);
+}
+
+image_t *filter_vertical_flip(image_t *image) {
+  return pointwise(NULL, image, vertical_flip_rows, NULL);
+}
+
+image_t *filter_to_hsv_mt(struct pool *pool, image_t *image) {
+  return pointwise(pool, image, to_hsv_rows, NULL);
+}
+
+image_t *filter_to_rgb_mt(struct pool *pool, image_t *image) {
+  return pointwise(pool, image, to_rgb_rows, NULL);
+}
+
+image_t *filter_add_pixel_mt(struct pool *pool, image_t *image,
+                             pixel_t *add_pixel) {
+  return pointwise(pool, image, add_pixel_rows, add_pixel);
+}
+
+image_t *filter_desaturate_mt(struct pool *pool, image_t *image) {
+  return pointwise(pool, image, desaturate_rows, NULL);
+}
+
+image_t *filter_horizontal_flip_mt(struct pool *pool, image_t *image) {
+  return pointwise(pool, image, horizontal_flip_rows, NULL);
+}
+
+image_t *filter_vertical_flip_mt(struct pool *pool, image_t *image) {
+  return pointwise(pool, image, vertical_flip_rows, NULL);
+}
+
+image_t *filter_to_hsv_into(image_t *dst, image_t *image) {
+  return pointwise_into(NULL, dst, image, to_hsv_rows, NULL);
+}
+
+image_t *filter_to_rgb_into(image_t *dst, image_t *image) {
+  return pointwise_into(NULL, dst, image, to_rgb_rows, NULL);
+}
+
+image_t *filter_add_pixel_into(image_t *dst, image_t *image,
+                               pixel_t *add_pixel) {
+  return pointwise_into(NULL, dst, image, add_pixel_rows, add_pixel);
+}
+
+image_t *filter_desaturate_into(image_t *dst, image_t *image) {
+  return pointwise_into(NULL, dst, image, desaturate_rows, NULL);
+}
+
+image_t *filter_horizontal_flip_into(image_t *dst, image_t *image) {
+  return horizontal_flip_into(NULL, dst, image);
+}
+
+image_t *filter_vertical_flip_into(image_t *dst, image_t *image) {
+  return vertical_flip_into(NULL, dst, image);
+}
+
+image_t *filter_to_hsv_into_mt(struct pool *pool, image_t *dst,
+                               image_t *image) {
+  return pointwise_into(pool, dst, image, to_hsv_rows, NULL);
+}
+
+image_t *filter_to_rgb_into_mt(struct pool *pool, image_t *dst,
+                               image_t *image) {
+  return pointwise_into(pool, dst, image, to_rgb_rows, NULL);
+}
+
+image_t *filter_add_pixel_into_mt(struct pool *pool, image_t *dst,
+                                  image_t *image, pixel_t *add_pixel) {
+  return pointwise_into(pool, dst, image, add_pixel_rows, add_pixel);
+}
+
+image_t *filter_desaturate_into_mt(struct pool *pool, image_t *dst,
+                                   image_t *image) {
+  return pointwise_into(pool, dst, image, desaturate_rows, NULL);
+}
+
+image_t *filter_horizontal_flip_into_mt(struct pool *pool, image_t *dst,
+                                        image_t *image) {
+  return horizontal_flip_into(pool, dst, image);
+}
+
+image_t *filter_vertical_flip_into_mt(struct pool *pool, image_t *dst,
+                                      image_t *image) {
+  return vertical_flip_into(pool, dst, image);
+}
+
+image_t *filter_to_hsv_inplace(image_t *image) {
+  return filter_to_hsv_into(image, image);
+}
+
+image_t *filter_to_rgb_inplace(image_t *image) {
+  return filter_to_rgb_into(image, image);
+}
+
+image_t *filter_add_pixel_inplace(image_t *image, pixel_t *add_pixel) {
+  return filter_add_pixel_into(image, image, add_pixel);
+}
+
+image_t *filter_desaturate_inplace(image_t *image) {
+  return filter_desaturate_into(image, image);
+}
+
+image_t *filter_horizontal_flip_inplace(image_t *image) {
+  return filter_horizontal_flip_into(image, image);
+}
+
+image_t *filter_vertical_flip_inplace(image_t *image) {
+  return filter_vertical_flip_into(image, image);
+}
+
+image_t *filter_to_hsv_inplace_mt(struct pool *pool, image_t *image) {
+  return filter_to_hsv_into_mt(pool, image, image);
+}
+
+image_t *filter_to_rgb_inplace_mt(struct pool *pool, image_t *image) {
+  return filter_to_rgb_into_mt(pool, image, image);
+}
+
+image_t *filter_add_pixel_inplace_mt(struct pool *pool, image_t *image,
+                                     pixel_t *add_pixel) {
+  return filter_add_pixel_into_mt(pool, image, image, add_pixel);
+}
+
+image_t *filter_desaturate_inplace_mt(struct pool *pool, image_t *image) {
+  return filter_desaturate_into_mt(pool, image, image);
+}
+
+image_t *filter_horizontal_flip_inplace_mt(struct pool *pool,
+                                           image_t *image) {
+  return filter_horizontal_flip_into_mt(pool, image, image);
+}
+
+image_t *filter_vertical_flip_inplace_mt(struct pool *pool, image_t *image) {
+  return filter_vertical_flip_into_mt(pool, image, image);
+}
+
+/* rows are rows of the new image, row y reads source rows y to y + 2 */
+static void convolution33_rows(struct filter_job *job, size_t y0, size_t y1) {
+  image_t *image = job->src;
+  image_t *new_image = job->dst;
+  const double(*m)[3] = job->m;
+
+  for (int j = y0 + 1; j < y1 + 1; j++) {
     for (int i = 1; i < image->width - 1; i++) {
       double values[3] = {0, 0, 0};
 
@@ -328,103 +642,90 @@ image_t *filter_convolution33(image_t *image, const double m[3][3]) {
       new_pixel->bytes[3] = pixel->bytes[3];
     }
   }
+}
 
-  return new_image;
+image_t *filter_convolution33_mt(struct pool *pool, image_t *image,
+                                 const double m[3][3]) {
+  struct filter_job job = {
+      .src = image,
+      .dst = image_create(image->id, image->width - 2, image->height - 2),
+      .m = m,
+      .rows = convolution33_rows,
+  };
 
-fail_exit:
-  return NULL;
+  return filter_run(pool, &job, image->height - 2);
 }
 
-image_t *filter_edge_identity(image_t *image) {
-  const double m[3][3] = {
-      {0, 0, 0},
-      {0, 1, 0},
-      {0, 0, 0},
-  };
+image_t *filter_convolution33(image_t *image, const double m[3][3]) {
+  return filter_convolution33_mt(NULL, image, m);
+}
 
-  return filter_convolution33(image, m);
+static const double edge_identity[3][3] = {
+    {0, 0, 0},
+    {0, 1, 0},
+    {0, 0, 0},
+};
+
+static const double edge_detect[3][3] = {
+    {-1, -1, -1},
+    {-1, 8, -1},
+    {-1, -1, -1},
+};
+
+static const double sharpen[3][3] = {
+    {0, -2, 0},
+    {-2, 9, -2},
+    {0, -2, 0},
+};
+
+static const double box_blur[3][3] = {
+    {1.0 / 9.0, 1.0 / 9.0, 1.0 / 9.0},
+    {1.0 / 9.0, 1.0 / 9.0, 1.0 / 9.0},
+    {1.0 / 9.0, 1.0 / 9.0, 1.0 / 9.0},
+};
+
+static const double gaussian_blur[3][3] = {
+    {1.0 / 16.0, 2.0 / 16.0, 1.0 / 16.0},
+    {2.0 / 16.0, 4.0 / 16.0, 4.0 / 16.0},
+    {1.0 / 16.0, 2.0 / 16.0, 1.0 / 16.0},
+};
+
+image_t *filter_edge_identity(image_t *image) {
+  return filter_convolution33(image, edge_identity);
 }
 
 image_t *filter_edge_detect(image_t *image) {
-  const double m[3][3] = {
-      {-1, -1, -1},
-      {-1, 8, -1},
-      {-1, -1, -1},
-  };
-
-  return filter_convolution33(image, m);
+  return filter_convolution33(image, edge_detect);
 }
 
 image_t *filter_sharpen(image_t *image) {
-  const double m[3][3] = {
-      {0, -2, 0},
-      {-2, 9, -2},
-      {0, -2, 0},
-  };
-
-  return filter_convolution33(image, m);
+  return filter_convolution33(image, sharpen);
 }
 
 image_t *filter_box_blur(image_t *image) {
-  const double m[3][3] = {
-      {1.0 / 9.0, 1.0 / 9.0, 1.0 / 9.0},
-      {1.0 / 9.0, 1.0 / 9.0, 1.0 / 9.0},
-      {1.0 / 9.0, 1.0 / 9.0, 1.0 / 9.0},
-  };
-
-  return filter_convolution33(image, m);
+  return filter_convolution33(image, box_blur);
 }
 
 image_t *filter_gaussian_blur(image_t *image) {
-  const double m[3][3] = {
-      {1.0 / 16.0, 2.0 / 16.0, 1.0 / 16.0},
-      {2.0 / 16.0, 4.0 / 16.0, 4.0 / 16.0},
-      {1.0 / 16.0, 2.0 / 16.0, 1.0 / 16.0},
-  };
-
-  return filter_convolution33(image, m);
+  return filter_convolution33(image, gaussian_blur);
 }
 
-image_t *filter_horizontal_flip(image_t *image) {
-  image_t *new_image = image_create(image->id, image->width, image->height);
-  if (new_image == NULL) {
-    goto fail_exit;
-  }
-
-  for (int j = 0; j < image->height; j++) {
-    for (int i = 0; i < image->width; i++) {
-      pixel_t *pixel = image_get_pixel(image, i, j);
-      pixel_t *new_pixel =
-          image_get_pixel(new_image, (image->width - 1) - i, j);
-
-      *new_pixel = *pixel;
-    }
-  }
-
-  return new_image;
-
-fail_exit:
-  return NULL;
+image_t *filter_edge_identity_mt(struct pool *pool, image_t *image) {
+  return filter_convolution33_mt(pool, image, edge_identity);
 }
 
-image_t *filter_vertical_flip(image_t *image) {
-  image_t *new_image = image_create(image->id, image->width, image->height);
-  if (new_image == NULL) {
-    goto fail_exit;
-  }
-
-  for (int j = 0; j < image->height; j++) {
-    for (int i = 0; i < image->width; i++) {
-      pixel_t *pixel = image_get_pixel(image, i, j);
-      pixel_t *new_pixel =
-          image_get_pixel(new_image, i, (image->height - j) - 1);
+image_t *filter_edge_detect_mt(struct pool *pool, image_t *image) {
+  return filter_convolution33_mt(pool, image, edge_detect);
+}
 
-      *new_pixel = *pixel;
-    }
-  }
+image_t *filter_sharpen_mt(struct pool *pool, image_t *image) {
+  return filter_convolution33_mt(pool, image, sharpen);
+}
 
-  return new_image;
+image_t *filter_box_blur_mt(struct pool *pool, image_t *image) {
+  return filter_convolution33_mt(pool, image, box_blur);
+}
 
-fail_exit:
-  return NULL;
+image_t *filter_gaussian_blur_mt(struct pool *pool, image_t *image) {
+  return filter_convolution33_mt(pool, image, gaussian_blur);
 }
@@ -31,6 +31,71 @@ image_t *filter_gaussian_blur(image_t *image);
 image_t *filter_horizontal_flip(image_t *image);
 image_t *filter_vertical_flip(image_t *image);
 
+/* same filters, with the rows of the new image split across the pool */
+
+struct pool;
+
+image_t *filter_scale_up_mt(struct pool *pool, image_t *image, size_t factor);
+image_t *filter_scale_up2_mt(struct pool *pool, image_t *image);
+image_t *filter_sobel_mt(struct pool *pool, image_t *image);
+image_t *filter_to_hsv_mt(struct pool *pool, image_t *image);
+image_t *filter_to_rgb_mt(struct pool *pool, image_t *image);
+image_t *filter_add_pixel_mt(struct pool *pool, image_t *image,
+                             pixel_t *add_pixel);
+image_t *filter_desaturate_mt(struct pool *pool, image_t *image);
+image_t *filter_convolution33_mt(struct pool *pool, image_t *image,
+                                 const double m[3][3]);
+image_t *filter_edge_identity_mt(struct pool *pool, image_t *image);
+image_t *filter_edge_detect_mt(struct pool *pool, image_t *image);
+image_t *filter_sharpen_mt(struct pool *pool, image_t *image);
+image_t *filter_box_blur_mt(struct pool *pool, image_t *image);
+image_t *filter_gaussian_blur_mt(struct pool *pool, image_t *image);
+image_t *filter_horizontal_flip_mt(struct pool *pool, image_t *image);
+image_t *filter_vertical_flip_mt(struct pool *pool, image_t *image);
+
+/*
+ * point-wise filters and flips writing into dst instead of a new image. dst
+ * must have the size of the source image and may be the source image itself.
+ * They return dst, or NULL if dst is NULL or its size differs. The _inplace
+ * forms overwrite the source image.
+ */
+
+image_t *filter_to_hsv_into(image_t *dst, image_t *image);
+image_t *filter_to_rgb_into(image_t *dst, image_t *image);
+image_t *filter_add_pixel_into(image_t *dst, image_t *image,
+                               pixel_t *add_pixel);
+image_t *filter_desaturate_into(image_t *dst, image_t *image);
+image_t *filter_horizontal_flip_into(image_t *dst, image_t *image);
+image_t *filter_vertical_flip_into(image_t *dst, image_t *image);
+
+image_t *filter_to_hsv_into_mt(struct pool *pool, image_t *dst,
+                               image_t *image);
+image_t *filter_to_rgb_into_mt(struct pool *pool, image_t *dst,
+                               image_t *image);
+image_t *filter_add_pixel_into_mt(struct pool *pool, image_t *dst,
+                                  image_t *image, pixel_t *add_pixel);
+image_t *filter_desaturate_into_mt(struct pool *pool, image_t *dst,
+                                   image_t *image);
+image_t *filter_horizontal_flip_into_mt(struct pool *pool, image_t *dst,
+                                        image_t *image);
+image_t *filter_vertical_flip_into_mt(struct pool *pool, image_t *dst,
+                                      image_t *image);
+
+image_t *filter_to_hsv_inplace(image_t *image);
+image_t *filter_to_rgb_inplace(image_t *image);
+image_t *filter_add_pixel_inplace(image_t *image, pixel_t *add_pixel);
+image_t *filter_desaturate_inplace(image_t *image);
+image_t *filter_horizontal_flip_inplace(image_t *image);
+image_t *filter_vertical_flip_inplace(image_t *image);
+
+image_t *filter_to_hsv_inplace_mt(struct pool *pool, image_t *image);
+image_t *filter_to_rgb_inplace_mt(struct pool *pool, image_t *image);
+image_t *filter_add_pixel_inplace_mt(struct pool *pool, image_t *image,
+                                     pixel_t *add_pixel);
+image_t *filter_desaturate_inplace_mt(struct pool *pool, image_t *image);
+image_t *filter_horizontal_flip_inplace_mt(struct pool *pool, image_t *image);
+image_t *filter_vertical_flip_inplace_mt(struct pool *pool, image_t *image);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,6 +1,7 @@
 #define _GNU_SOURCE
 #include <dirent.h>
 #include <getopt.h>
+#include <png.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,43 +9,115 @@
 #include <sys/sysinfo.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <zlib.h>
 
+#include "image.h"
 #include "log.h"
+#include "perfstat.h"
+#include "pipeline.h"
 #include "processing.h"
 #include "threadpool.h"
+#include "trace.h"
 #include "utils.h"
 
 struct app {
   char *input;
   char *output;
   int multithread;
+  int lpt;
+  int numa;
+  int elastic;
+  size_t memory_budget;
+  int stats;
+  const char *trace;
+  int counters;
+  int parallel_encode;
+  int pipeline;
+  struct pipeline_attr pipeline_attr;
+  image_png_opts_t png;
   struct list *work_list;
   int nb_threads;
 };
 
-void print_usage() { fprintf(stderr, "Usage: %s [-ioenh]\n", "ieffect"); }
+void print_usage() {
+  fprintf(stderr, "Usage: %s [-iomnlaebstcpzZfwPh]\n", "ieffect");
+}
+
+struct png_name {
+  const char *name;
+  int value;
+};
+
+static const struct png_name png_strategies[] = {
+    {"auto", -1},
+    {"default", Z_DEFAULT_STRATEGY},
+    {"filtered", Z_FILTERED},
+    {"huffman", Z_HUFFMAN_ONLY},
+    {"rle", Z_RLE},
+    {"fixed", Z_FIXED},
+    {NULL, 0},
+};
+
+static const struct png_name png_filters[] = {
+    {"auto", -1},
+    {"none", PNG_FILTER_NONE},
+    {"sub", PNG_FILTER_SUB},
+    {"up", PNG_FILTER_UP},
+    {"avg", PNG_FILTER_AVG},
+    {"paeth", PNG_FILTER_PAETH},
+    {"all", PNG_ALL_FILTERS},
+    {NULL, 0},
+};
+
+// Valeur du nom dans la table, -2 si le nom est inconnu
+static int png_lookup(const struct png_name *names, const char *name) {
+  for (int i = 0; names[i].name; i++) {
+    if (strcmp(names[i].name, name) == 0) {
+      return names[i].value;
+    }
+  }
+  return -2;
+}
 
 int main(int argc, char **argv) {
   int ret = 0;
   printf("ieffect\n");
 
   struct option options[] = {
-      {"input", 1, 0, 'i'},       {"output", 1, 0, 'o'},
-      {"multithread", 0, 0, 'm'}, {"nb-thread", 1, 0, 'n'},
-      {"help", 0, 0, 'h'},        {0, 0, 0, 0}};
+      {"input", 1, 0, 'i'},         {"output", 1, 0, 'o'},
+      {"multithread", 0, 0, 'm'},   {"nb-thread", 1, 0, 'n'},
+      {"lpt", 0, 0, 'l'},           {"pipeline", 1, 0, 'p'},
+      {"numa", 0, 0, 'a'},          {"elastic", 0, 0, 'e'},
+      {"memory-budget", 1, 0, 'b'}, {"stats", 0, 0, 's'},
+      {"trace", 1, 0, 't'},         {"counters", 0, 0, 'c'},
+      {"png-level", 1, 0, 'z'},     {"png-strategy", 1, 0, 'Z'},
+      {"png-filter", 1, 0, 'f'},    {"png-buffer", 1, 0, 'w'},
+      {"parallel-encode", 0, 0, 'P'}, {"help", 0, 0, 'h'},
+      {0, 0, 0, 0}};
 
   struct app app = {
       .input = NULL,              //
       .output = NULL,             //
       .multithread = 0,           //
+      .lpt = 0,                   //
+      .numa = 0,                  //
+      .elastic = 0,               //
+      .memory_budget = 0,         //
+      .stats = 0,                 //
+      .trace = NULL,              //
+      .counters = 0,              //
+      .parallel_encode = 0,       //
+      .pipeline = 0,              //
       .nb_threads = get_nprocs(), //
   };
 
   app.work_list = list_new(NULL, free_work_item);
+  image_png_opts_init(&app.png);
 
   int opt;
   int idx;
-  while ((opt = getopt_long(argc, argv, "i:o:n:mh", options, &idx)) != -1) {
+  while ((opt = getopt_long(argc, argv, "i:o:n:mlaeb:st:cp:z:Z:f:w:Ph",
+                            options, &idx)) != -1) {
     printf("opt=%d optarg=%s\n", opt, optarg);
     switch (opt) {
     case 'i':
@@ -59,6 +132,75 @@ int main(int argc, char **argv) {
     case 'n':
       app.nb_threads = atoi(optarg);
       break;
+    case 'l':
+      app.lpt = 1;
+      break;
+    case 'a':
+      app.numa = 1;
+      break;
+    case 'e':
+      app.elastic = 1;
+      break;
+    case 'b':
+      // En Mio
+      app.memory_budget = strtoull(optarg, NULL, 10) << 20;
+      break;
+    case 's':
+      app.stats = 1;
+      break;
+    case 't':
+      // Préfixe des fichiers de trace: <trace>.txt et <trace>.json
+      app.trace = optarg;
+      break;
+    case 'c':
+      app.counters = 1;
+      break;
+    case 'p': {
+      // Threads de décodage, de filtres et d'encodage: -p 1,4,3
+      struct pipeline_attr *attr = &app.pipeline_attr;
+      pipeline_attr_init(attr, 1);
+      if (sscanf(optarg, "%d,%d,%d", &attr->nb_threads[PIPELINE_DECODE],
+                 &attr->nb_threads[PIPELINE_FILTER],
+                 &attr->nb_threads[PIPELINE_ENCODE]) != 3) {
+        print_usage();
+        ret = 1;
+        goto out_list;
+      }
+      app.pipeline = 1;
+    } break;
+    case 'z':
+      app.png.level = atoi(optarg);
+      if (app.png.level < 0 || app.png.level > 9) {
+        print_usage();
+        ret = 1;
+        goto out_list;
+      }
+      break;
+    case 'Z':
+      // auto, default, filtered, huffman, rle ou fixed
+      app.png.strategy = png_lookup(png_strategies, optarg);
+      if (app.png.strategy == -2) {
+        print_usage();
+        ret = 1;
+        goto out_list;
+      }
+      break;
+    case 'f':
+      // auto, none, sub, up, avg, paeth ou all
+      app.png.filters = png_lookup(png_filters, optarg);
+      if (app.png.filters == -2) {
+        print_usage();
+        ret = 1;
+        goto out_list;
+      }
+      break;
+    case 'P':
+      app.parallel_encode = 1;
+      break;
+    case 'w':
+      // En Kio
+      app.png.buffer_size = strtoull(optarg, NULL, 10) << 10;
+      break;
     default:
       print_usage();
     }
@@ -71,6 +213,19 @@ int main(int argc, char **argv) {
     printf(" output          : %s\n", app.output);
     printf(" multithread     : %d\n", app.multithread);
     printf(" nb_threads      : %d\n", app.nb_threads);
+    printf(" lpt             : %d\n", app.lpt);
+    printf(" numa            : %d\n", app.numa);
+    printf(" elastic         : %d\n", app.elastic);
+    printf(" memory_budget   : %zu\n", app.memory_budget);
+    printf(" stats           : %d\n", app.stats);
+    printf(" trace           : %s\n", app.trace);
+    printf(" counters        : %d\n", app.counters);
+    printf(" pipeline        : %d\n", app.pipeline);
+    printf(" png_level       : %d\n", app.png.level);
+    printf(" png_strategy    : %d\n", app.png.strategy);
+    printf(" png_filters     : %d\n", app.png.filters);
+    printf(" png_buffer      : %zu\n", app.png.buffer_size);
+    printf(" parallel_encode : %d\n", app.parallel_encode);
   }
 
   if (app.nb_threads < 1 || app.nb_threads > 128) {
@@ -109,7 +264,7 @@ int main(int argc, char **argv) {
       goto out_list;
     }
 
-    struct work_item *item = malloc(sizeof(struct work_item));
+    struct work_item *item = calloc(1, sizeof(struct work_item));
     item->input_file = strdup(app.input);
     item->output_file = strdup(app.output);
     struct list_node *n = list_node_new(item);
@@ -151,10 +306,49 @@ int main(int argc, char **argv) {
 
   printf("Number of files to process: %lu\n", list_size(app.work_list));
 
-  if (app.multithread) {
-    process_multithread(app.work_list, app.nb_threads);
-  } else {
-    process_serial(app.work_list);
+  image_png_set_defaults(&app.png);
+
+  if (app.trace) {
+    trace_start();
+  }
+  if (app.counters && perfstat_start() == 0) {
+    printf("hardware counters unavailable, measuring time only\n");
+  }
+
+  if (app.pipeline) {
+    struct pipeline_stats stats;
+    if (process_pipeline(app.work_list, &app.pipeline_attr, &stats) < 0) {
+      ret = 1;
+    }
+    pipeline_stats_print(stdout, &stats);
+  } else if (app.multithread) {
+    struct process_opts opts;
+    process_opts_init(&opts);
+    opts.lpt = app.lpt;
+    opts.elastic = app.elastic;
+    opts.memory_budget = app.memory_budget;
+    opts.stats = app.stats;
+    opts.parallel_encode = app.parallel_encode;
+    if (app.counters) {
+      // Chaque étape d'une image sur un seul thread, voir perfstat.h
+      opts.split = PROCESS_SPLIT_NEVER;
+    }
+    if (app.numa) {
+      opts.affinity = THREADPOOL_AFFINITY_NUMA;
+    }
+    if (process_multithread_opts(app.work_list, app.nb_threads, &opts) < 0) {
+      ret = 1;
+    }
+  } else if (process_serial(app.work_list) < 0) {
+    ret = 1;
+  }
+
+  if (app.counters) {
+    perfstat_print(stdout);
+    perfstat_stop();
+  }
+  if (app.trace && trace_dump(app.trace) < 0) {
+    ret = 1;
   }
 
 out_list:
@@ -6,8 +6,11 @@
 
 #include <png.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <zlib.h>
 
+#include "bufpool.h"
 #include "image.h"
 #include "log.h"
 
@@ -22,10 +25,11 @@ image_t *image_create(size_t id, size_t width, size_t height) {
   image->width = width;
   image->height = height;
 
+  /* pixel buffers are recycled across filters and images */
   image->pixels =
-      malloc((image->width * image->height) * sizeof(*image->pixels));
+      bufpool_alloc((image->width * image->height) * sizeof(*image->pixels));
   if (image->pixels == NULL) {
-    LOG_ERROR_ERRNO("malloc");
+    LOG_ERROR_ERRNO("bufpool_alloc");
     goto fail_free_image;
   }
 
@@ -64,21 +68,18 @@ image_t *image_create_from_png(const char *filename) {
     goto fail_free_png_struct;
   }
 
+  /* modified after setjmp, must be reloaded from memory after a longjmp */
+  image_t *volatile image = NULL;
+
   if (setjmp(png_jmpbuf(png))) {
-    goto fail_free_png_info;
+    goto fail_free_image;
   }
 
   png_init_io(png, file);
   png_read_info(png, info);
 
-  image_t *image = image_create(0, png_get_image_width(png, info),
-                                png_get_image_height(png, info));
-  if (image == NULL) {
-    goto fail_free_png_info;
-  }
-
   png_byte color = png_get_color_type(png, info);
-  png_byte depth = png_get_color_type(png, info);
+  png_byte depth = png_get_bit_depth(png, info);
 
   /* read any color_type into 8 bit depth, RGBA format */
 
@@ -111,62 +112,46 @@ image_t *image_create_from_png(const char *filename) {
     png_set_gray_to_rgb(png);
   }
 
-  png_read_update_info(png, info);
+  /* interlaced images are read row by row once per pass */
+  int passes = png_set_interlace_handling(png);
 
-  /* read image data */
+  png_read_update_info(png, info);
 
-  png_bytep *row_pointers = calloc(image->height, sizeof(*row_pointers));
-  if (row_pointers == NULL) {
-    goto fail_free_image;
+  image = image_create(0, png_get_image_width(png, info),
+                       png_get_image_height(png, info));
+  if (image == NULL) {
+    goto fail_free_png_info;
   }
 
-  for (int j = 0; j < image->height; j++) {
-    row_pointers[j] = malloc(png_get_rowbytes(png, info));
-    if (row_pointers[j] == NULL) {
-      goto fail_free_rows;
-    }
-  }
+  /* rows are now 8 bit RGBA, the same layout as a row of pixel_t */
 
-  png_read_image(png, row_pointers);
+  if (png_get_rowbytes(png, info) != image->width * sizeof(pixel_t)) {
+    LOG_ERROR("unexpected png row size");
+    goto fail_free_image;
+  }
 
-  /* copy image data */
+  /* read image data straight into the pixel buffer, without copy */
 
-  for (int j = 0; j < image->height; j++) {
-    for (int i = 0; i < image->width; i++) {
-      pixel_t *pixel = image_get_pixel(image, i, j);
-      pixel->bytes[0] = row_pointers[j][4 * i + 0];
-      pixel->bytes[1] = row_pointers[j][4 * i + 1];
-      pixel->bytes[2] = row_pointers[j][4 * i + 2];
-      pixel->bytes[3] = row_pointers[j][4 * i + 3];
+  for (int pass = 0; pass < passes; pass++) {
+    for (size_t j = 0; j < image->height; j++) {
+      png_read_row(png, (png_bytep)(image->pixels + j * image->width), NULL);
     }
   }
 
   /* cleanup */
 
-  for (int j = 0; j < image->height; j++) {
-    if (row_pointers[j] != NULL) {
-      free(row_pointers[j]);
-    }
-  }
-  free(row_pointers);
-
   png_destroy_read_struct(&png, &info, NULL);
   fclose(file);
 
   return image;
 
-fail_free_rows:
-  for (int j = 0; j < image->height; j++) {
-    if (row_pointers[j] != NULL) {
-      free(row_pointers[j]);
-    }
-  }
-  free(row_pointers);
 fail_free_image:
-  image_destroy(image);
+  if (image != NULL) {
+    image_destroy(image);
+  }
 fail_free_png_info:
   png_destroy_read_struct(&png, &info, NULL);
-  goto fail_free_image;
+  goto fail_close_file;
 fail_free_png_struct:
   png_destroy_read_struct(&png, NULL, NULL);
 fail_close_file:
@@ -175,6 +160,43 @@ fail_exit:
   return NULL;
 }
 
+int image_png_size(const char *filename, size_t *width, size_t *height) {
+  if (filename == NULL || width == NULL || height == NULL) {
+    LOG_ERROR_NULL_PTR();
+    goto fail_exit;
+  }
+
+  /* IHDR is always the first chunk, right after the 8 byte signature */
+
+  FILE *file = fopen(filename, "rb");
+  if (file == NULL) {
+    LOG_ERROR_ERRNO("fopen");
+    goto fail_exit;
+  }
+
+  png_byte header[24];
+  if (fread(header, 1, sizeof(header), file) != sizeof(header)) {
+    LOG_ERROR("truncated png header");
+    goto fail_close_file;
+  }
+
+  if (png_sig_cmp(header, 0, 8) != 0 || memcmp(header + 12, "IHDR", 4) != 0) {
+    LOG_ERROR("not a png file");
+    goto fail_close_file;
+  }
+
+  *width = png_get_uint_32(header + 16);
+  *height = png_get_uint_32(header + 20);
+  fclose(file);
+
+  return 0;
+
+fail_close_file:
+  fclose(file);
+fail_exit:
+  return -1;
+}
+
 image_t *image_copy(image_t *image) {
   image_t *new_image = image_create(image->id, image->width, image->height);
   if (new_image == NULL) {
@@ -198,13 +220,38 @@ fail_exit:
 
 void image_destroy(image_t *image) {
   if (image->pixels != NULL) {
-    free(image->pixels);
+    bufpool_free(image->pixels);
   }
   free(image);
 }
 
+static image_png_opts_t png_defaults = {
+    .level = Z_DEFAULT_COMPRESSION,
+    .strategy = -1,
+    .filters = -1,
+    .buffer_size = 0,
+};
+
+void image_png_opts_init(image_png_opts_t *opts) {
+  opts->level = Z_DEFAULT_COMPRESSION;
+  opts->strategy = -1;
+  opts->filters = -1;
+  opts->buffer_size = 0;
+}
+
+void image_png_set_defaults(const image_png_opts_t *opts) {
+  png_defaults = *opts;
+}
+
+void image_png_get_defaults(image_png_opts_t *opts) { *opts = png_defaults; }
+
 int image_save_png(image_t *image, const char *filename) {
-  if (image == NULL || filename == NULL) {
+  return image_save_png_opts(image, filename, &png_defaults);
+}
+
+int image_save_png_opts(image_t *image, const char *filename,
+                        const image_png_opts_t *opts) {
+  if (image == NULL || filename == NULL || opts == NULL) {
     LOG_ERROR_NULL_PTR();
     goto fail_exit;
   }
@@ -217,6 +264,11 @@ int image_save_png(image_t *image, const char *filename) {
     goto fail_exit;
   }
 
+  /* let each IDAT chunk reach write() in one piece */
+  if (opts->buffer_size > 0) {
+    setvbuf(file, NULL, _IOFBF, opts->buffer_size);
+  }
+
   png_structp png =
       png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
   if (png == NULL) {
@@ -236,6 +288,19 @@ int image_save_png(image_t *image, const char *filename) {
 
   png_init_io(png, file);
 
+  /* compression settings, they must be set before writing the header */
+
+  png_set_compression_level(png, opts->level);
+  if (opts->strategy >= 0) {
+    png_set_compression_strategy(png, opts->strategy);
+  }
+  if (opts->filters >= 0) {
+    png_set_filter(png, PNG_FILTER_TYPE_BASE, opts->filters);
+  }
+  if (opts->buffer_size > 0) {
+    png_set_compression_buffer_size(png, opts->buffer_size);
+  }
+
   /* output is 8 bit depth, RGBA format */
 
   png_set_IHDR(png, info, image->width, image->height, 8, PNG_COLOR_TYPE_RGBA,
@@ -244,56 +309,23 @@ int image_save_png(image_t *image, const char *filename) {
 
   png_write_info(png, info);
 
-  /* copy image data */
+  /* write PNG file, a row of pixel_t is already an 8 bit RGBA row */
 
-  png_bytep *row_pointers = calloc(image->height, sizeof(*row_pointers));
-  if (row_pointers == NULL) {
-    goto fail_free_png_struct;
-  }
-
-  for (int j = 0; j < image->height; j++) {
-    row_pointers[j] = malloc(png_get_rowbytes(png, info));
-    if (row_pointers[j] == NULL) {
-      goto fail_free_rows;
-    }
-  }
-
-  for (int j = 0; j < image->height; j++) {
-    for (int i = 0; i < image->width; i++) {
-      pixel_t *pixel = image_get_pixel(image, i, j);
-      row_pointers[j][4 * i + 0] = pixel->bytes[0];
-      row_pointers[j][4 * i + 1] = pixel->bytes[1];
-      row_pointers[j][4 * i + 2] = pixel->bytes[2];
-      row_pointers[j][4 * i + 3] = pixel->bytes[3];
-    }
+  for (size_t j = 0; j < image->height; j++) {
+    png_write_row(png, (png_const_bytep)(image->pixels + j * image->width));
   }
-
-  /* write PNG file */
-
-  png_write_image(png, row_pointers);
   png_write_end(png, NULL);
 
   /* cleanup */
 
-  for (int j = 0; j < image->height; j++) {
-    if (row_pointers[j] != NULL) {
-      free(row_pointers[j]);
-    }
-  }
-  free(row_pointers);
-
   png_destroy_write_struct(&png, &info);
-  fclose(file);
+  if (fclose(file) != 0) {
+    LOG_ERROR_ERRNO("fclose");
+    goto fail_exit;
+  }
 
   return 0;
 
-fail_free_rows:
-  for (int j = 0; j < image->height; j++) {
-    if (row_pointers[j] != NULL) {
-      free(row_pointers[j]);
-    }
-  }
-  free(row_pointers);
 fail_free_png_info:
   png_destroy_write_struct(&png, &info);
   goto fail_close_file;
@@ -36,9 +36,31 @@ static inline pixel_t *image_get_pixel(image_t *image, unsigned int x,
 
 image_t *image_create(size_t id, size_t width, size_t height);
 image_t *image_create_from_png(const char *filename);
+/* reads only the png header, returns 0 on success */
+int image_png_size(const char *filename, size_t *width, size_t *height);
 image_t *image_copy(image_t *image);
 void image_destroy(image_t *image);
+
+/*
+ * PNG encoder settings. The defaults are libpng's: zlib level 6, adaptive row
+ * filters. Faster settings such as level 1 or the Z_RLE strategy with the
+ * "sub" or "none" filter give bigger files in a fraction of the time.
+ */
+typedef struct image_png_opts {
+  int level;          /* zlib level 0-9, Z_DEFAULT_COMPRESSION (-1) */
+  int strategy;       /* Z_FILTERED, Z_RLE, ..., -1 for libpng's choice */
+  int filters;        /* mask of PNG_FILTER_*, -1 for libpng's choice */
+  size_t buffer_size; /* zlib output buffer and IDAT size, 0 for default */
+} image_png_opts_t;
+
+void image_png_opts_init(image_png_opts_t *opts);
+/* settings used by image_save_png, set them before any thread saves images */
+void image_png_set_defaults(const image_png_opts_t *opts);
+void image_png_get_defaults(image_png_opts_t *opts);
+
 int image_save_png(image_t *image, const char *filename);
+int image_save_png_opts(image_t *image, const char *filename,
+                        const image_png_opts_t *opts);
 
 typedef struct image_dir {
   char *name;
@@ -0,0 +1,225 @@
+#include "parallel.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Durée visée pour une tranche avec grain automatique
+#define PFOR_TARGET_NS 50000
+// Durée minimale de la mesure faite par l'appelant avant de distribuer
+#define PFOR_PROBE_NS 10000
+// Tranches par participant, pour équilibrer la charge
+#define PFOR_CHUNKS_PER_THREAD 4
+// Attente active avant de bloquer sur la fin des dernières tranches
+#define PFOR_SPIN 1000
+
+struct pfor_job {
+  size_t next;       // prochain indice à distribuer
+  size_t end;
+  size_t grain;
+  size_t remaining;  // indices pas encore traités
+  int refs;          // l'appelant et les tâches auxiliaires
+  int next_slot;
+  int done;
+  pthread_mutex_t lock;
+  pthread_cond_t finished;
+
+  range_fn for_fn;
+  reduce_fn reduce_fn;
+  void* ctx;
+  size_t size;
+  unsigned char slots[];  // accumulateurs des tâches auxiliaires
+};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void run_range(range_fn for_fn, reduce_fn reduce_fn, void* ctx,
+                             size_t begin, size_t end, void* acc) {
+  if (for_fn) {
+    for_fn(ctx, begin, end);
+  } else {
+    reduce_fn(ctx, begin, end, acc);
+  }
+}
+
+static void pfor_release(struct pfor_job* job) {
+  if (__atomic_sub_fetch(&job->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    pthread_mutex_destroy(&job->lock);
+    pthread_cond_destroy(&job->finished);
+    free(job);
+  }
+}
+
+// Prendre des tranches jusqu'à épuisement de l'intervalle
+static void pfor_run_chunks(struct pfor_job* job, void* acc) {
+  while (1) {
+    size_t lo = __atomic_fetch_add(&job->next, job->grain, __ATOMIC_RELAXED);
+    if (lo >= job->end) {
+      break;
+    }
+    size_t hi = lo + job->grain < job->end ? lo + job->grain : job->end;
+    run_range(job->for_fn, job->reduce_fn, job->ctx, lo, hi, acc);
+
+    if (__atomic_sub_fetch(&job->remaining, hi - lo, __ATOMIC_ACQ_REL) == 0) {
+      pthread_mutex_lock(&job->lock);
+      job->done = 1;
+      pthread_cond_broadcast(&job->finished);
+      pthread_mutex_unlock(&job->lock);
+    }
+  }
+}
+
+static void* pfor_helper(void* arg) {
+  struct pfor_job* job = arg;
+  int slot = __atomic_fetch_add(&job->next_slot, 1, __ATOMIC_RELAXED);
+  pfor_run_chunks(job, job->slots + slot * job->size);
+  pfor_release(job);
+  return NULL;
+}
+
+// Attendre que les tranches prises par les tâches auxiliaires soient finies
+static void pfor_wait(struct pfor_job* job) {
+  for (int i = 0; i < PFOR_SPIN; i++) {
+    if (__atomic_load_n(&job->remaining, __ATOMIC_ACQUIRE) == 0) {
+      return;
+    }
+    cpu_relax();
+  }
+  pthread_mutex_lock(&job->lock);
+  while (!job->done) {
+    pthread_cond_wait(&job->finished, &job->lock);
+  }
+  pthread_mutex_unlock(&job->lock);
+}
+
+// Exécuter sur place des tranches de taille croissante jusqu'à avoir mesuré
+// assez de travail, puis en déduire le grain. Retourne 0 si le reste de
+// l'intervalle est trop court pour valoir la peine d'être distribué.
+static size_t pfor_auto_grain(int nb_participants, size_t* begin, size_t end,
+                              range_fn for_fn, reduce_fn reduce_fn, void* ctx,
+                              void* acc) {
+  size_t probe = 1;
+  size_t measured = 0;
+  uint64_t spent = 0;
+
+  while (*begin < end && spent < PFOR_PROBE_NS) {
+    size_t hi = end - *begin > probe ? *begin + probe : end;
+    uint64_t start = now_ns();
+    run_range(for_fn, reduce_fn, ctx, *begin, hi, acc);
+    spent += now_ns() - start;
+    measured += hi - *begin;
+    *begin = hi;
+    probe *= 2;
+  }
+
+  size_t remaining = end - *begin;
+  double per_index = (double)spent / measured;
+  if (remaining == 0 || per_index * remaining < 2 * PFOR_TARGET_NS) {
+    return 0;
+  }
+
+  size_t grain = PFOR_TARGET_NS / per_index;
+  size_t balanced = remaining / (PFOR_CHUNKS_PER_THREAD * nb_participants);
+  if (grain > balanced) {
+    grain = balanced;
+  }
+  return grain > 0 ? grain : 1;
+}
+
+static void parallel_run(struct pool* pool, size_t begin, size_t end,
+                         size_t grain, size_t size, const void* identity,
+                         range_fn for_fn, reduce_fn reduce_fn,
+                         combine_fn combine, void* ctx, void* result) {
+  if (size) {
+    memcpy(result, identity, size);
+  }
+  if (begin >= end) {
+    return;
+  }
+
+  // L'appelant accumule directement dans result
+  int nb_others = pool->nb_threads - (threadpool_worker_id(pool) >= 0);
+  if (grain == 0) {
+    grain = pfor_auto_grain(nb_others + 1, &begin, end, for_fn, reduce_fn, ctx,
+                            result);
+    if (grain == 0) {
+      run_range(for_fn, reduce_fn, ctx, begin, end, result);
+      return;
+    }
+  }
+
+  size_t nb_chunks = (end - begin + grain - 1) / grain;
+  int nb_helpers = nb_others;
+  if (nb_chunks - 1 < (size_t)nb_helpers) {
+    nb_helpers = nb_chunks - 1;
+  }
+  if (nb_helpers <= 0) {
+    run_range(for_fn, reduce_fn, ctx, begin, end, result);
+    return;
+  }
+
+  struct pfor_job* job = malloc(sizeof(*job) + nb_helpers * size);
+  if (!job) {
+    perror("malloc");
+    run_range(for_fn, reduce_fn, ctx, begin, end, result);
+    return;
+  }
+  job->next = begin;
+  job->end = end;
+  job->grain = grain;
+  job->remaining = end - begin;
+  job->refs = nb_helpers + 1;
+  job->next_slot = 0;
+  job->done = 0;
+  pthread_mutex_init(&job->lock, NULL);
+  pthread_cond_init(&job->finished, NULL);
+  job->for_fn = for_fn;
+  job->reduce_fn = reduce_fn;
+  job->ctx = ctx;
+  job->size = size;
+  for (int i = 0; size && i < nb_helpers; i++) {
+    memcpy(job->slots + i * size, identity, size);
+  }
+
+  // Soumettre les tâches auxiliaires en un seul lot
+  void* args[64];
+  for (int i = 0; i < 64; i++) {
+    args[i] = job;
+  }
+  for (int i = 0; i < nb_helpers; i += 64) {
+    int n = nb_helpers - i < 64 ? nb_helpers - i : 64;
+    threadpool_add_tasks(pool, pfor_helper, args, n);
+  }
+
+  pfor_run_chunks(job, result);
+  pfor_wait(job);
+
+  // Une tâche auxiliaire qui démarre en retard ne trouve plus de tranche et ne
+  // touche plus à son accumulateur
+  if (combine) {
+    for (int i = 0; i < nb_helpers; i++) {
+      combine(ctx, result, job->slots + i * size);
+    }
+  }
+  pfor_release(job);
+}
+
+void threadpool_parallel_for(struct pool* pool, size_t begin, size_t end,
+                             size_t grain, range_fn fn, void* ctx) {
+  parallel_run(pool, begin, end, grain, 0, NULL, fn, NULL, NULL, ctx, NULL);
+}
+
+void threadpool_parallel_reduce(struct pool* pool, size_t begin, size_t end,
+                                size_t grain, size_t size,
+                                const void* identity, reduce_fn fn,
+                                combine_fn combine, void* ctx, void* result) {
+  parallel_run(pool, begin, end, grain, size, identity, NULL, fn, combine, ctx,
+               result);
+}
@@ -0,0 +1,50 @@
+#ifndef INF3170_PARALLEL_H_
+#define INF3170_PARALLEL_H_
+
+#include <stddef.h>
+
+#include "threadpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Boucles parallèles sur un intervalle d'indices [begin, end).
+ *
+ * L'intervalle est distribué par tranches de grain indices à l'appelant et à
+ * des tâches auxiliaires du pool, qui prennent les tranches au fur et à mesure.
+ * L'appelant participe au calcul: la boucle se termine même si aucun
+ * travailleur n'est libre, et peut donc être appelée depuis une tâche du pool.
+ *
+ * Avec grain == 0, la taille des tranches est choisie en chronométrant les
+ * premières itérations; un intervalle trop court pour amortir la distribution
+ * est exécuté entièrement par l'appelant.
+ */
+
+typedef void (*range_fn)(void *ctx, size_t begin, size_t end);
+
+void threadpool_parallel_for(struct pool *pool, size_t begin, size_t end,
+                             size_t grain, range_fn fn, void *ctx);
+
+/*
+ * Réduction: chaque participant accumule ses tranches dans un accumulateur
+ * privé de size octets initialisé à identity, puis les accumulateurs sont
+ * combinés dans result (lui aussi initialisé à identity). L'ordre de
+ * combinaison n'est pas déterministe; combine doit être associative et
+ * commutative.
+ */
+
+typedef void (*reduce_fn)(void *ctx, size_t begin, size_t end, void *acc);
+typedef void (*combine_fn)(void *ctx, void *acc, const void *partial);
+
+void threadpool_parallel_reduce(struct pool *pool, size_t begin, size_t end,
+                                size_t grain, size_t size,
+                                const void *identity, reduce_fn fn,
+                                combine_fn combine, void *ctx, void *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
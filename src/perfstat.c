@@ -0,0 +1,253 @@
+#define _GNU_SOURCE
+#include "perfstat.h"
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Compteurs d'un thread, lus ensemble par le premier ouvert
+struct perfstat_group {
+  struct perfstat_group* next;
+  int fds[PERFSTAT_NB_COUNTERS];    // -1 si le noyau a refusé le compteur
+  int index[PERFSTAT_NB_COUNTERS];  // position dans la lecture du groupe
+  int nb;
+};
+
+// Lecture d'un groupe avec PERF_FORMAT_GROUP et les temps d'activité
+struct perfstat_read {
+  uint64_t nr;
+  uint64_t enabled_ns;
+  uint64_t running_ns;
+  uint64_t values[PERFSTAT_NB_COUNTERS];
+};
+
+static const uint64_t events[PERFSTAT_NB_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,  // dernier niveau de cache
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+int perfstat_enabled;
+
+static struct perfstat_stage stages[PERFSTAT_MAX_STAGES];
+static int available[PERFSTAT_NB_COUNTERS];
+static int warned;
+
+// Groupes de tous les threads, fermés par perfstat_stop()
+static struct perfstat_group* groups;
+static pthread_mutex_t groups_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int generation;
+
+static __thread struct perfstat_group* local_group;
+static __thread unsigned int local_generation;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int perf_open(uint64_t config, int group_fd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = group_fd < 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd,
+                 PERF_FLAG_FD_CLOEXEC);
+}
+
+// Groupe du thread appelant, ouvert à sa première mesure
+static struct perfstat_group* perfstat_local(void) {
+  unsigned int gen = __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+  if (local_group && local_generation == gen) {
+    return local_group;
+  }
+
+  struct perfstat_group* group = malloc(sizeof(struct perfstat_group));
+  if (!group) {
+    perror("malloc");
+    return NULL;
+  }
+  group->nb = 0;
+  int leader = -1;
+  for (int i = 0; i < PERFSTAT_NB_COUNTERS; i++) {
+    group->fds[i] = perf_open(events[i], leader);
+    group->index[i] = -1;
+    if (group->fds[i] < 0) {
+      if (!__atomic_exchange_n(&warned, 1, __ATOMIC_RELAXED)) {
+        fprintf(stderr, "perf_event_open: %s, counter not available\n",
+                strerror(errno));
+      }
+      continue;
+    }
+    if (leader < 0) {
+      leader = group->fds[i];
+    }
+    group->index[i] = group->nb++;
+    __atomic_store_n(&available[i], 1, __ATOMIC_RELAXED);
+  }
+  if (leader >= 0) {
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+
+  pthread_mutex_lock(&groups_lock);
+  group->next = groups;
+  groups = group;
+  pthread_mutex_unlock(&groups_lock);
+  local_group = group;
+  local_generation = gen;
+  return group;
+}
+
+// Lire les compteurs du thread; sans compteur, seul le temps est rempli
+static void perfstat_read(struct perfstat_sample* sample) {
+  memset(sample, 0, sizeof(*sample));
+  struct perfstat_group* group = perfstat_local();
+  if (group && group->nb > 0) {
+    struct perfstat_read buf;
+    int leader = -1;
+    for (int i = 0; i < PERFSTAT_NB_COUNTERS && leader < 0; i++) {
+      leader = group->fds[i];
+    }
+    if (read(leader, &buf, sizeof(buf)) > 0) {
+      for (int i = 0; i < PERFSTAT_NB_COUNTERS; i++) {
+        if (group->index[i] >= 0) {
+          sample->values[i] = buf.values[group->index[i]];
+        }
+      }
+      sample->enabled_ns = buf.enabled_ns;
+      sample->running_ns = buf.running_ns;
+    }
+  }
+  sample->ns = now_ns();
+}
+
+void perfstat_begin(struct perfstat_sample* sample) {
+  if (!__atomic_load_n(&perfstat_enabled, __ATOMIC_RELAXED)) {
+    return;
+  }
+  perfstat_read(sample);
+}
+
+void perfstat_end(int stage, const char* name,
+                  const struct perfstat_sample* sample, uint64_t pixels) {
+  if (!__atomic_load_n(&perfstat_enabled, __ATOMIC_RELAXED) || stage < 0 ||
+      stage >= PERFSTAT_MAX_STAGES) {
+    return;
+  }
+  struct perfstat_sample end;
+  perfstat_read(&end);
+
+  // Compteurs multiplexés: extrapoler au temps où le groupe était actif
+  double scale = 1.0;
+  uint64_t running = end.running_ns - sample->running_ns;
+  uint64_t enabled = end.enabled_ns - sample->enabled_ns;
+  if (running > 0 && running < enabled) {
+    scale = (double)enabled / running;
+  }
+
+  struct perfstat_stage* s = &stages[stage];
+  __atomic_store_n(&s->name, name, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&s->nb_calls, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&s->pixels, pixels, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&s->ns, end.ns - sample->ns, __ATOMIC_RELAXED);
+  for (int i = 0; i < PERFSTAT_NB_COUNTERS; i++) {
+    uint64_t delta = end.values[i] - sample->values[i];
+    __atomic_add_fetch(&s->values[i], (uint64_t)(delta * scale),
+                       __ATOMIC_RELAXED);
+  }
+}
+
+void perfstat_stop(void) {
+  __atomic_store_n(&perfstat_enabled, 0, __ATOMIC_RELEASE);
+  pthread_mutex_lock(&groups_lock);
+  while (groups) {
+    struct perfstat_group* next = groups->next;
+    for (int i = 0; i < PERFSTAT_NB_COUNTERS; i++) {
+      if (groups->fds[i] >= 0) {
+        close(groups->fds[i]);
+      }
+    }
+    free(groups);
+    groups = next;
+  }
+  pthread_mutex_unlock(&groups_lock);
+  __atomic_add_fetch(&generation, 1, __ATOMIC_RELEASE);
+}
+
+int perfstat_start(void) {
+  perfstat_stop();
+  memset(stages, 0, sizeof(stages));
+  memset(available, 0, sizeof(available));
+  __atomic_store_n(&perfstat_enabled, 1, __ATOMIC_RELEASE);
+  struct perfstat_group* group = perfstat_local();
+  return group ? group->nb : 0;
+}
+
+int perfstat_get(int stage, struct perfstat_stage* out) {
+  if (stage < 0 || stage >= PERFSTAT_MAX_STAGES) {
+    return -1;
+  }
+  struct perfstat_stage* s = &stages[stage];
+  out->name = __atomic_load_n(&s->name, __ATOMIC_RELAXED);
+  out->nb_calls = __atomic_load_n(&s->nb_calls, __ATOMIC_RELAXED);
+  out->pixels = __atomic_load_n(&s->pixels, __ATOMIC_RELAXED);
+  out->ns = __atomic_load_n(&s->ns, __ATOMIC_RELAXED);
+  for (int i = 0; i < PERFSTAT_NB_COUNTERS; i++) {
+    out->values[i] = __atomic_load_n(&s->values[i], __ATOMIC_RELAXED);
+  }
+  return out->nb_calls ? 0 : -1;
+}
+
+int perfstat_available(enum perfstat_counter counter) {
+  return __atomic_load_n(&available[counter], __ATOMIC_RELAXED);
+}
+
+// Valeur par mégapixel, ou « n/a » si le compteur n'a pas pu être ouvert
+static void print_per_mpx(FILE* out, const struct perfstat_stage* s,
+                          enum perfstat_counter counter) {
+  if (!perfstat_available(counter) || s->pixels == 0) {
+    fprintf(out, " %14s", "n/a");
+    return;
+  }
+  fprintf(out, " %14.0f", s->values[counter] * 1e6 / s->pixels);
+}
+
+void perfstat_print(FILE* out) {
+  fprintf(out, "%-14s %8s %10s %8s %6s %14s %14s\n", "stage", "calls",
+          "time (ms)", "ns/px", "IPC", "LLC miss/Mpx", "br miss/Mpx");
+  for (int i = 0; i < PERFSTAT_MAX_STAGES; i++) {
+    struct perfstat_stage s;
+    if (perfstat_get(i, &s) < 0) {
+      continue;
+    }
+    fprintf(out, "%-14s %8lu %10.3f %8.2f", s.name ? s.name : "?",
+            (unsigned long)s.nb_calls, s.ns * 1e-6,
+            s.pixels ? (double)s.ns / s.pixels : 0.0);
+    if (perfstat_available(PERFSTAT_CYCLES) &&
+        perfstat_available(PERFSTAT_INSTRUCTIONS) &&
+        s.values[PERFSTAT_CYCLES] > 0) {
+      fprintf(out, " %6.2f",
+              (double)s.values[PERFSTAT_INSTRUCTIONS] /
+                  s.values[PERFSTAT_CYCLES]);
+    } else {
+      fprintf(out, " %6s", "n/a");
+    }
+    print_per_mpx(out, &s, PERFSTAT_LLC_MISSES);
+    print_per_mpx(out, &s, PERFSTAT_BRANCH_MISSES);
+    fprintf(out, "\n");
+  }
+}
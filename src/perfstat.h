@@ -0,0 +1,83 @@
+#ifndef INF3170_PERFSTAT_H_
+#define INF3170_PERFSTAT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Compteurs matériels par étape du traitement d'une image (perf_event_open).
+ *
+ * Chaque thread ouvre son groupe de compteurs à sa première mesure; les
+ * compteurs ne comptent que le code utilisateur du thread. Une étape est
+ * encadrée par perfstat_begin() et perfstat_end(), qui ajoute la différence aux
+ * totaux de l'étape. Si le noyau refuse un compteur (perf_event_paranoid,
+ * machine virtuelle sans PMU), il est affiché « n/a »; sans aucun compteur,
+ * seul le temps est mesuré.
+ *
+ * Un filtre dont les lignes sont découpées sur un pool n'est compté que pour
+ * la part du thread qui l'appelle: mesurer les filtres avec
+ * PROCESS_SPLIT_NEVER.
+ *
+ * perfstat_start() et perfstat_stop() ne doivent être appelées que lorsque les
+ * threads mesurés sont au repos.
+ */
+
+enum perfstat_counter {
+  PERFSTAT_CYCLES,
+  PERFSTAT_INSTRUCTIONS,
+  PERFSTAT_LLC_MISSES,
+  PERFSTAT_BRANCH_MISSES,
+  PERFSTAT_NB_COUNTERS,
+};
+
+#define PERFSTAT_MAX_STAGES 16
+
+// Valeurs lues au début d'une étape
+struct perfstat_sample {
+  uint64_t ns;
+  uint64_t values[PERFSTAT_NB_COUNTERS];
+  uint64_t enabled_ns;  // temps pendant lequel le groupe était actif
+  uint64_t running_ns;  // temps pendant lequel il était sur le PMU
+};
+
+// Totaux d'une étape
+struct perfstat_stage {
+  const char *name;
+  uint64_t nb_calls;
+  uint64_t pixels;
+  uint64_t ns;
+  uint64_t values[PERFSTAT_NB_COUNTERS];
+};
+
+extern int perfstat_enabled;
+
+// Remettre les totaux à zéro et commencer à mesurer. Retourne le nombre de
+// compteurs matériels disponibles pour le thread appelant, 0 en temps seul.
+int perfstat_start(void);
+// Arrêter la mesure et fermer les compteurs de tous les threads
+void perfstat_stop(void);
+
+void perfstat_begin(struct perfstat_sample *sample);
+// Ajouter l'étape stage, qui a traité pixels pixels, depuis perfstat_begin().
+// name doit rester valide jusqu'à perfstat_print().
+void perfstat_end(int stage, const char *name,
+                  const struct perfstat_sample *sample, uint64_t pixels);
+
+// Copier les totaux de l'étape; retourne -1 si elle n'a jamais été mesurée
+int perfstat_get(int stage, struct perfstat_stage *out);
+// 1 si le compteur a pu être ouvert dans au moins un thread
+int perfstat_available(enum perfstat_counter counter);
+
+// Une ligne par étape: temps, IPC, défauts de cache et erreurs de prédiction
+// par mégapixel
+void perfstat_print(FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,360 @@
+#include "pipeline.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "image.h"
+#include "processing.h"
+#include "trace.h"
+
+#define PIPELINE_QUEUE_CAPACITY 4
+
+// File bornée bloquante entre deux étages
+struct bqueue {
+  void** items;
+  size_t capacity;
+  size_t head;
+  size_t count;
+  int nb_producers;  // la file est fermée quand le dernier producteur a fini
+  int closed;        // pipeline annulé: push échoue et pop retourne NULL
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+};
+
+// Image qui traverse le pipeline
+struct pipeline_msg {
+  struct work_item* item;
+  image_t* img;
+};
+
+struct pipeline {
+  struct pipeline_msg* msgs;
+  size_t nb_msgs;
+  size_t next_msg;  // prochaine image à décoder
+  struct bqueue queues[PIPELINE_NB_STAGES - 1];
+
+  size_t in_flight;
+  size_t max_in_flight;
+  int failed;
+  uint64_t busy_ns[PIPELINE_NB_STAGES];
+  size_t nb_images[PIPELINE_NB_STAGES];
+};
+
+static const char* const stage_names[PIPELINE_NB_STAGES] = {
+    "decode", "filter", "encode"};
+
+struct stage_arg {
+  struct pipeline* pipeline;
+  enum pipeline_stage stage;
+};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bqueue_init(struct bqueue* q, size_t capacity, int nb_producers) {
+  q->items = malloc(capacity * sizeof(void*));
+  if (!q->items) {
+    perror("malloc");
+    return -1;
+  }
+  q->capacity = capacity;
+  q->head = 0;
+  q->count = 0;
+  q->nb_producers = nb_producers;
+  q->closed = 0;
+  pthread_mutex_init(&q->lock, NULL);
+  pthread_cond_init(&q->not_empty, NULL);
+  pthread_cond_init(&q->not_full, NULL);
+  return 0;
+}
+
+static void bqueue_destroy(struct bqueue* q) {
+  pthread_mutex_destroy(&q->lock);
+  pthread_cond_destroy(&q->not_empty);
+  pthread_cond_destroy(&q->not_full);
+  free(q->items);
+}
+
+// Bloque tant que la file est pleine; retourne -1 si la file a été fermée
+static int bqueue_push(struct bqueue* q, void* item) {
+  pthread_mutex_lock(&q->lock);
+  while (q->count == q->capacity && !q->closed) {
+    pthread_cond_wait(&q->not_full, &q->lock);
+  }
+  if (q->closed) {
+    pthread_mutex_unlock(&q->lock);
+    return -1;
+  }
+  q->items[(q->head + q->count) % q->capacity] = item;
+  q->count++;
+  pthread_cond_signal(&q->not_empty);
+  pthread_mutex_unlock(&q->lock);
+  return 0;
+}
+
+// Bloque tant que la file est vide; retourne NULL si elle est vide et que ses
+// producteurs ont fini, ou si elle a été fermée
+static void* bqueue_pop(struct bqueue* q) {
+  void* item = NULL;
+  pthread_mutex_lock(&q->lock);
+  while (q->count == 0 && q->nb_producers > 0 && !q->closed) {
+    pthread_cond_wait(&q->not_empty, &q->lock);
+  }
+  if (q->count > 0 && !q->closed) {
+    item = q->items[q->head];
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+  }
+  pthread_mutex_unlock(&q->lock);
+  return item;
+}
+
+// Réveiller tous les threads bloqués sur la file, qui ne sert plus
+static void bqueue_close(struct bqueue* q) {
+  pthread_mutex_lock(&q->lock);
+  q->closed = 1;
+  pthread_cond_broadcast(&q->not_empty);
+  pthread_cond_broadcast(&q->not_full);
+  pthread_mutex_unlock(&q->lock);
+}
+
+// Libérer les images restées dans une file fermée, sans thread actif
+static void bqueue_drain(struct bqueue* q) {
+  while (q->count > 0) {
+    struct pipeline_msg* msg = q->items[q->head];
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+    image_destroy(msg->img);
+    msg->img = NULL;
+  }
+}
+
+static void bqueue_producer_done(struct bqueue* q) {
+  pthread_mutex_lock(&q->lock);
+  if (--q->nb_producers == 0) {
+    pthread_cond_broadcast(&q->not_empty);
+  }
+  pthread_mutex_unlock(&q->lock);
+}
+
+static struct pipeline_msg* stage_next(struct pipeline* p,
+                                       enum pipeline_stage stage) {
+  if (stage == PIPELINE_DECODE) {
+    size_t i = __atomic_fetch_add(&p->next_msg, 1, __ATOMIC_RELAXED);
+    return i < p->nb_msgs ? &p->msgs[i] : NULL;
+  }
+  return bqueue_pop(&p->queues[stage - 1]);
+}
+
+static void in_flight_add(struct pipeline* p) {
+  size_t n = __atomic_add_fetch(&p->in_flight, 1, __ATOMIC_RELAXED);
+  size_t max = __atomic_load_n(&p->max_in_flight, __ATOMIC_RELAXED);
+  while (n > max && !__atomic_compare_exchange_n(&p->max_in_flight, &max, n, 1,
+                                                 __ATOMIC_RELAXED,
+                                                 __ATOMIC_RELAXED)) {
+  }
+}
+
+// Retourne 0 si l'image doit passer à l'étage suivant
+static int stage_run(struct pipeline* p, enum pipeline_stage stage,
+                     struct pipeline_msg* msg) {
+  const char* fname = msg->item->input_file;
+
+  switch (stage) {
+  case PIPELINE_DECODE:
+    printf("processing image: %s\n", fname);
+    trace_begin(TRACE_IO, "read_png");
+    msg->img = image_create_from_png(fname);
+    trace_end(TRACE_IO, "read_png");
+    if (!msg->img) {
+      printf("failed to load image %s\n", fname);
+      return -1;
+    }
+    in_flight_add(p);
+    return 0;
+  case PIPELINE_FILTER:
+    msg->img = process_apply_filters(msg->img, NULL);
+    if (!msg->img) {
+      printf("failed to process image%s\n", fname);
+      __atomic_sub_fetch(&p->in_flight, 1, __ATOMIC_RELAXED);
+      return -1;
+    }
+    return 0;
+  default:
+    break;
+  }
+
+  trace_begin(TRACE_IO, "write_png");
+  int ret = image_save_png(msg->img, msg->item->output_file);
+  trace_end(TRACE_IO, "write_png");
+  image_destroy(msg->img);
+  msg->img = NULL;
+  __atomic_sub_fetch(&p->in_flight, 1, __ATOMIC_RELAXED);
+  return ret ? -1 : 0;
+}
+
+static void* stage_worker(void* arg) {
+  struct stage_arg* sa = arg;
+  struct pipeline* p = sa->pipeline;
+  enum pipeline_stage stage = sa->stage;
+  uint64_t busy = 0;
+  size_t done = 0;
+
+  struct pipeline_msg* msg;
+  while ((msg = stage_next(p, stage)) != NULL) {
+    uint64_t start = now_ns();
+    trace_begin(TRACE_TASK, stage_names[stage]);
+    int ret = stage_run(p, stage, msg);
+    trace_end(TRACE_TASK, stage_names[stage]);
+    busy += now_ns() - start;
+
+    if (ret) {
+      __atomic_store_n(&p->failed, 1, __ATOMIC_RELAXED);
+      continue;
+    }
+    done++;
+    if (stage + 1 < PIPELINE_NB_STAGES &&
+        bqueue_push(&p->queues[stage], msg) < 0) {
+      // Pipeline annulé
+      image_destroy(msg->img);
+      msg->img = NULL;
+    }
+  }
+
+  if (stage + 1 < PIPELINE_NB_STAGES) {
+    bqueue_producer_done(&p->queues[stage]);
+  }
+  __atomic_add_fetch(&p->busy_ns[stage], busy, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&p->nb_images[stage], done, __ATOMIC_RELAXED);
+  return NULL;
+}
+
+// Annuler le pipeline après un échec au démarrage: plus aucune image n'est
+// décodée et les files sont fermées pour que les threads lancés se terminent
+static void pipeline_cancel(struct pipeline* p) {
+  __atomic_store_n(&p->failed, 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&p->next_msg, p->nb_msgs, __ATOMIC_RELAXED);
+  for (int s = 0; s < PIPELINE_NB_STAGES - 1; s++) {
+    bqueue_close(&p->queues[s]);
+  }
+}
+
+void pipeline_attr_init(struct pipeline_attr* attr, int nb_threads) {
+  // L'encodage traite quatre fois plus de pixels que le décodage, à cause de
+  // filter_scale_up2, et deflate est plus lent qu'inflate
+  int decode = nb_threads / 6;
+  int encode = nb_threads / 3;
+  attr->nb_threads[PIPELINE_DECODE] = decode > 0 ? decode : 1;
+  attr->nb_threads[PIPELINE_ENCODE] = encode > 0 ? encode : 1;
+  int filter = nb_threads - attr->nb_threads[PIPELINE_DECODE] -
+               attr->nb_threads[PIPELINE_ENCODE];
+  attr->nb_threads[PIPELINE_FILTER] = filter > 0 ? filter : 1;
+  attr->queue_capacity = PIPELINE_QUEUE_CAPACITY;
+}
+
+int process_pipeline(struct list* items, const struct pipeline_attr* attr,
+                     struct pipeline_stats* stats) {
+  int ret = -1;
+  uint64_t start = now_ns();
+  if (stats) {
+    memset(stats, 0, sizeof(*stats));
+  }
+
+  int nb_threads = 0;
+  for (int s = 0; s < PIPELINE_NB_STAGES; s++) {
+    if (attr->nb_threads[s] < 1 || attr->queue_capacity < 1) {
+      printf("invalid pipeline attributes\n");
+      return -1;
+    }
+    nb_threads += attr->nb_threads[s];
+  }
+
+  struct pipeline p = {0};
+  p.nb_msgs = list_size(items);
+  p.msgs = calloc(p.nb_msgs ? p.nb_msgs : 1, sizeof(*p.msgs));
+  pthread_t* threads = malloc(nb_threads * sizeof(*threads));
+  struct stage_arg* args = malloc(nb_threads * sizeof(*args));
+  if (!p.msgs || !threads || !args) {
+    perror("malloc");
+    goto out_free;
+  }
+
+  size_t i = 0;
+  struct list_node* node = list_head(items);
+  while (!list_end(node)) {
+    p.msgs[i++].item = node->data;
+    node = node->next;
+  }
+
+  int nb_queues = 0;
+  for (; nb_queues < PIPELINE_NB_STAGES - 1; nb_queues++) {
+    if (bqueue_init(&p.queues[nb_queues], attr->queue_capacity,
+                    attr->nb_threads[nb_queues]) < 0) {
+      goto out_queues;
+    }
+  }
+
+  int nb_started = 0;
+  for (int s = 0; s < PIPELINE_NB_STAGES; s++) {
+    for (int t = 0; t < attr->nb_threads[s]; t++) {
+      args[nb_started].pipeline = &p;
+      args[nb_started].stage = s;
+      if (pthread_create(&threads[nb_started], NULL, stage_worker,
+                         &args[nb_started]) != 0) {
+        // Fermer les files pour que les threads déjà lancés se terminent
+        perror("pthread_create");
+        pipeline_cancel(&p);
+        goto out_join;
+      }
+      nb_started++;
+    }
+  }
+
+out_join:
+  for (int t = 0; t < nb_started; t++) {
+    pthread_join(threads[t], NULL);
+  }
+  for (int s = 0; s < PIPELINE_NB_STAGES - 1; s++) {
+    bqueue_drain(&p.queues[s]);
+  }
+  ret = p.failed ? -1 : 0;
+
+  if (stats) {
+    stats->wall_ns = now_ns() - start;
+    for (int s = 0; s < PIPELINE_NB_STAGES; s++) {
+      stats->nb_threads[s] = attr->nb_threads[s];
+      stats->busy_ns[s] = p.busy_ns[s];
+      stats->nb_images[s] = p.nb_images[s];
+    }
+    stats->max_in_flight = p.max_in_flight;
+  }
+
+out_queues:
+  while (nb_queues-- > 0) {
+    bqueue_destroy(&p.queues[nb_queues]);
+  }
+out_free:
+  free(args);
+  free(threads);
+  free(p.msgs);
+  return ret;
+}
+
+void pipeline_stats_print(FILE* out, const struct pipeline_stats* stats) {
+  fprintf(out, "pipeline: %.3f s, max %zu images in flight\n",
+          stats->wall_ns * 1e-9, stats->max_in_flight);
+  for (int s = 0; s < PIPELINE_NB_STAGES; s++) {
+    double capacity = (double)stats->wall_ns * stats->nb_threads[s];
+    fprintf(out, " %-8s %3d threads %6zu images %8.3f s busy %5.1f%%\n",
+            stage_names[s], stats->nb_threads[s], stats->nb_images[s],
+            stats->busy_ns[s] * 1e-9,
+            capacity > 0 ? 100.0 * stats->busy_ns[s] / capacity : 0.0);
+  }
+}
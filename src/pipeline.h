@@ -0,0 +1,59 @@
+#ifndef INF3170_PIPELINE_H_
+#define INF3170_PIPELINE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Traitement des images en trois étages: décodage PNG, filtres et encodage
+ * PNG. Chaque étage a ses propres threads, et deux étages consécutifs sont
+ * reliés par une file bornée. Un étage qui produit plus vite que le suivant
+ * bloque quand la file est pleine, ce qui borne le nombre d'images en mémoire:
+ * au plus un par thread plus queue_capacity par file.
+ */
+
+enum pipeline_stage {
+  PIPELINE_DECODE,
+  PIPELINE_FILTER,
+  PIPELINE_ENCODE,
+  PIPELINE_NB_STAGES,
+};
+
+struct pipeline_attr {
+  int nb_threads[PIPELINE_NB_STAGES];
+  size_t queue_capacity;  // capacité de chaque file entre deux étages
+};
+
+/*
+ * busy_ns est le temps passé à traiter des images, sans l'attente sur les
+ * files; l'utilisation d'un étage est busy_ns / (wall_ns * nb_threads). Un
+ * étage proche de 100% alors que les autres attendent est le goulot.
+ */
+struct pipeline_stats {
+  uint64_t wall_ns;
+  int nb_threads[PIPELINE_NB_STAGES];
+  uint64_t busy_ns[PIPELINE_NB_STAGES];
+  size_t nb_images[PIPELINE_NB_STAGES];  // images traitées avec succès
+  size_t max_in_flight;                  // images décodées au même moment
+};
+
+// Répartir nb_threads entre les étages, au moins un thread par étage
+void pipeline_attr_init(struct pipeline_attr *attr, int nb_threads);
+
+// Retourne -1 si une image n'a pas pu être traitée; stats peut être NULL
+int process_pipeline(struct list *items, const struct pipeline_attr *attr,
+                     struct pipeline_stats *stats);
+
+void pipeline_stats_print(FILE *out, const struct pipeline_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,404 @@
+#include "pngpar.h"
+
+#include <png.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "bufpool.h"
+#include "parallel.h"
+
+#define WINDOW_SIZE 32768  // fenêtre de deflate
+#define BPP 4              // octets par pixel, RGBA 8 bits
+#define NB_FILTER_TYPES 5
+
+// Tranche de lignes compressée par une tâche
+struct chunk {
+  size_t row_begin;
+  size_t row_end;
+  unsigned char* out;  // données de l'IDAT de la tranche
+  size_t out_len;
+  uLong adler;  // des lignes filtrées de la tranche
+  uLong crc;    // du type "IDAT" et de out
+  int error;
+};
+
+struct pngpar_job {
+  image_t* image;
+  size_t row_bytes;  // octet de filtre compris
+  int level;
+  int strategy;
+  int filters;  // masque de PNG_FILTER_*
+  struct chunk* chunks;
+  size_t nb_chunks;
+};
+
+static inline int paeth(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = abs(p - a);
+  int pb = abs(p - b);
+  int pc = abs(p - c);
+  if (pa <= pb && pa <= pc) {
+    return a;
+  }
+  return pb <= pc ? b : c;
+}
+
+/*
+ * Ligne cur filtrée avec type dans out, octet de filtre compris. prev est la
+ * ligne précédente, des zéros pour la première ligne. Une boucle par filtre,
+ * les BPP premiers octets à part, pour que le compilateur les vectorise.
+ */
+static void apply_filter(int type, const unsigned char* restrict cur,
+                         const unsigned char* restrict prev, size_t len,
+                         unsigned char* restrict out) {
+  out[0] = type;
+  out++;
+  switch (type) {
+  case PNG_FILTER_VALUE_SUB:
+    memcpy(out, cur, BPP);
+    for (size_t i = BPP; i < len; i++) {
+      out[i] = cur[i] - cur[i - BPP];
+    }
+    break;
+  case PNG_FILTER_VALUE_UP:
+    for (size_t i = 0; i < len; i++) {
+      out[i] = cur[i] - prev[i];
+    }
+    break;
+  case PNG_FILTER_VALUE_AVG:
+    for (size_t i = 0; i < BPP; i++) {
+      out[i] = cur[i] - (prev[i] >> 1);
+    }
+    for (size_t i = BPP; i < len; i++) {
+      out[i] = cur[i] - ((cur[i - BPP] + prev[i]) >> 1);
+    }
+    break;
+  case PNG_FILTER_VALUE_PAETH:
+    for (size_t i = 0; i < BPP; i++) {
+      out[i] = cur[i] - prev[i];
+    }
+    for (size_t i = BPP; i < len; i++) {
+      out[i] = cur[i] - paeth(cur[i - BPP], prev[i], prev[i - BPP]);
+    }
+    break;
+  default:
+    memcpy(out, cur, len);
+  }
+}
+
+// Heuristique de libpng: somme des octets filtrés vus comme signés
+static uint64_t filter_cost(const unsigned char* row, size_t len) {
+  uint64_t sum = 0;
+  for (size_t i = 1; i < len; i++) {
+    sum += abs((signed char)row[i]);
+  }
+  return sum;
+}
+
+// Ligne y filtrée dans out; tmp sert au choix adaptatif, zero est une ligne
+// de zéros qui précède la première
+static void filter_row(const struct pngpar_job* job, size_t y,
+                       unsigned char* out, unsigned char* tmp,
+                       const unsigned char* zero) {
+  image_t* image = job->image;
+  const unsigned char* cur =
+      (const unsigned char*)(image->pixels + y * image->width);
+  const unsigned char* prev =
+      y > 0 ? (const unsigned char*)(image->pixels + (y - 1) * image->width)
+            : zero;
+  size_t len = job->row_bytes - 1;
+
+  unsigned char* best = NULL;
+  uint64_t best_cost = UINT64_MAX;
+  for (int type = 0; type < NB_FILTER_TYPES; type++) {
+    if (!(job->filters & (PNG_FILTER_NONE << type))) {
+      continue;
+    }
+    unsigned char* dst = best == out ? tmp : out;
+    apply_filter(type, cur, prev, len, dst);
+    if (job->filters == (PNG_FILTER_NONE << type)) {
+      return;
+    }
+    uint64_t cost = filter_cost(dst, job->row_bytes);
+    if (cost < best_cost) {
+      best_cost = cost;
+      best = dst;
+    }
+  }
+  if (best != out) {
+    memcpy(out, best, job->row_bytes);
+  }
+}
+
+// En-tête zlib: fenêtre de 32 Kio, niveau indicatif comme deflateInit()
+static void zlib_header(int level, int strategy, unsigned char* out) {
+  int flevel = 2;
+  if (level >= 0 && (level < 2 || strategy >= Z_HUFFMAN_ONLY)) {
+    flevel = 0;
+  } else if (level >= 0 && level < 6) {
+    flevel = 1;
+  } else if (level > 6) {
+    flevel = 3;
+  }
+  unsigned int header = (0x78 << 8) | (flevel << 6);
+  header += 31 - header % 31;
+  out[0] = header >> 8;
+  out[1] = header & 0xff;
+}
+
+static int deflate_chunk(const struct pngpar_job* job, size_t index,
+                         const unsigned char* in, size_t in_len,
+                         const unsigned char* dict, size_t dict_len) {
+  struct chunk* c = &job->chunks[index];
+  int last = index == job->nb_chunks - 1;
+  z_stream strm;
+  memset(&strm, 0, sizeof(strm));
+  if (deflateInit2(&strm, job->level, Z_DEFLATED, -15, 8, job->strategy) !=
+      Z_OK) {
+    fprintf(stderr, "deflateInit2: %s\n", strm.msg ? strm.msg : "error");
+    return -1;
+  }
+  if (dict_len > 0) {
+    deflateSetDictionary(&strm, dict, dict_len);
+  }
+
+  // La première tranche porte l'en-tête zlib
+  size_t header_len = index == 0 ? 2 : 0;
+  size_t cap = header_len + deflateBound(&strm, in_len) + 64;
+  c->out = malloc(cap);
+  if (!c->out) {
+    perror("malloc");
+    deflateEnd(&strm);
+    return -1;
+  }
+  if (index == 0) {
+    zlib_header(job->level, job->strategy, c->out);
+  }
+
+  strm.next_in = (unsigned char*)in;
+  strm.avail_in = in_len;
+  int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+  size_t len = header_len;
+  for (;;) {
+    strm.next_out = c->out + len;
+    strm.avail_out = cap - len;
+    int ret = deflate(&strm, flush);
+    len = cap - strm.avail_out;
+    if (ret == Z_STREAM_ERROR) {
+      fprintf(stderr, "deflate: %s\n", strm.msg ? strm.msg : "error");
+      deflateEnd(&strm);
+      return -1;
+    }
+    if (last ? ret == Z_STREAM_END
+             : strm.avail_in == 0 && strm.avail_out > 0) {
+      break;
+    }
+    unsigned char* out = realloc(c->out, cap * 2);
+    if (!out) {
+      perror("realloc");
+      deflateEnd(&strm);
+      return -1;
+    }
+    c->out = out;
+    cap *= 2;
+  }
+  deflateEnd(&strm);
+
+  c->out_len = len;
+  c->adler = adler32(adler32(0, NULL, 0), in, in_len);
+  c->crc = crc32(crc32(0, (const Bytef*)"IDAT", 4), c->out, len);
+  return 0;
+}
+
+// Filtrer puis compresser une tranche, avec les lignes précédentes comme
+// dictionnaire
+static int compress_chunk(const struct pngpar_job* job, size_t index) {
+  struct chunk* c = &job->chunks[index];
+  size_t dict_rows = (WINDOW_SIZE + job->row_bytes - 1) / job->row_bytes;
+  if (dict_rows > c->row_begin) {
+    dict_rows = c->row_begin;
+  }
+  size_t first = c->row_begin - dict_rows;
+  size_t nb_rows = c->row_end - first;
+
+  // Lignes filtrées du dictionnaire et de la tranche, une ligne de travail et
+  // une ligne de zéros pour la première ligne de l'image
+  unsigned char* buf = bufpool_alloc((nb_rows + 2) * job->row_bytes);
+  if (!buf) {
+    perror("bufpool_alloc");
+    return -1;
+  }
+  unsigned char* tmp = buf + nb_rows * job->row_bytes;
+  unsigned char* zero = tmp + job->row_bytes;
+  if (first == 0) {
+    memset(zero, 0, job->row_bytes);
+  }
+  for (size_t y = first; y < c->row_end; y++) {
+    filter_row(job, y, buf + (y - first) * job->row_bytes, tmp, zero);
+  }
+
+  size_t dict_len = dict_rows * job->row_bytes;
+  size_t skip = dict_len > WINDOW_SIZE ? dict_len - WINDOW_SIZE : 0;
+  int ret = deflate_chunk(job, index, buf + dict_len,
+                          (c->row_end - c->row_begin) * job->row_bytes,
+                          buf + skip, dict_len - skip);
+  bufpool_free(buf);
+  return ret;
+}
+
+static void compress_range(void* ctx, size_t begin, size_t end) {
+  struct pngpar_job* job = ctx;
+  for (size_t i = begin; i < end; i++) {
+    if (compress_chunk(job, i) < 0) {
+      job->chunks[i].error = 1;
+    }
+  }
+}
+
+static void put_u32(unsigned char* p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+// Bloc PNG: longueur, type, données et CRC déjà calculé sur type et données
+static int write_chunk(FILE* file, const char* type, const unsigned char* data,
+                       size_t len, uLong crc) {
+  unsigned char head[8];
+  unsigned char tail[4];
+  put_u32(head, len);
+  memcpy(head + 4, type, 4);
+  put_u32(tail, crc);
+  if (fwrite(head, 1, 8, file) != 8 ||
+      (len > 0 && fwrite(data, 1, len, file) != len) ||
+      fwrite(tail, 1, 4, file) != 4) {
+    perror("fwrite");
+    return -1;
+  }
+  return 0;
+}
+
+static int write_small_chunk(FILE* file, const char* type,
+                             const unsigned char* data, size_t len) {
+  // crc32() d'un pointeur NULL retourne la valeur initiale, pas crc
+  uLong crc = crc32(0, (const Bytef*)type, 4);
+  if (len > 0) {
+    crc = crc32(crc, data, len);
+  }
+  return write_chunk(file, type, data, len, crc);
+}
+
+static int write_png(const struct pngpar_job* job, FILE* file) {
+  static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+  if (fwrite(signature, 1, sizeof(signature), file) != sizeof(signature)) {
+    perror("fwrite");
+    return -1;
+  }
+
+  // 8 bits par composante, RGBA, sans entrelacement
+  unsigned char ihdr[13];
+  put_u32(ihdr, job->image->width);
+  put_u32(ihdr + 4, job->image->height);
+  ihdr[8] = 8;
+  ihdr[9] = PNG_COLOR_TYPE_RGBA;
+  ihdr[10] = PNG_COMPRESSION_TYPE_BASE;
+  ihdr[11] = PNG_FILTER_TYPE_BASE;
+  ihdr[12] = PNG_INTERLACE_NONE;
+  if (write_small_chunk(file, "IHDR", ihdr, sizeof(ihdr)) < 0) {
+    return -1;
+  }
+
+  // Un IDAT par tranche, puis l'Adler-32 du flux entier
+  uLong adler = job->chunks[0].adler;
+  for (size_t i = 0; i < job->nb_chunks; i++) {
+    const struct chunk* c = &job->chunks[i];
+    if (i > 0) {
+      adler = adler32_combine(adler, c->adler,
+                              (c->row_end - c->row_begin) * job->row_bytes);
+    }
+    if (write_chunk(file, "IDAT", c->out, c->out_len, c->crc) < 0) {
+      return -1;
+    }
+  }
+  unsigned char trailer[4];
+  put_u32(trailer, adler);
+  if (write_small_chunk(file, "IDAT", trailer, sizeof(trailer)) < 0) {
+    return -1;
+  }
+
+  return write_small_chunk(file, "IEND", NULL, 0);
+}
+
+int pngpar_save(struct pool* pool, image_t* image, const char* filename,
+                const image_png_opts_t* opts) {
+  struct pngpar_job job = {
+      .image = image,
+      .row_bytes = 1 + image->width * BPP,
+      .level = opts->level,
+      .strategy = opts->strategy,
+      .filters = opts->filters < 0 ? PNG_ALL_FILTERS : opts->filters,
+  };
+  if (job.filters == 0) {
+    job.filters = PNG_FILTER_NONE;
+  }
+  // Comme libpng: Z_FILTERED dès que les lignes sont filtrées
+  if (job.strategy < 0) {
+    job.strategy =
+        job.filters == PNG_FILTER_NONE ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+  }
+
+  size_t rows_per_chunk = PNGPAR_CHUNK_SIZE / job.row_bytes;
+  if (rows_per_chunk == 0) {
+    rows_per_chunk = 1;
+  }
+  job.nb_chunks = (image->height + rows_per_chunk - 1) / rows_per_chunk;
+  if (!pool || job.nb_chunks < 2) {
+    return image_save_png_opts(image, filename, opts);
+  }
+
+  job.chunks = calloc(job.nb_chunks, sizeof(struct chunk));
+  if (!job.chunks) {
+    perror("calloc");
+    return -1;
+  }
+  for (size_t i = 0; i < job.nb_chunks; i++) {
+    job.chunks[i].row_begin = i * rows_per_chunk;
+    job.chunks[i].row_end = (i + 1) * rows_per_chunk < image->height
+                                ? (i + 1) * rows_per_chunk
+                                : image->height;
+  }
+
+  threadpool_parallel_for(pool, 0, job.nb_chunks, 1, compress_range, &job);
+
+  int ret = 0;
+  for (size_t i = 0; i < job.nb_chunks; i++) {
+    ret |= job.chunks[i].error ? -1 : 0;
+  }
+
+  if (ret == 0) {
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+      perror("fopen");
+      ret = -1;
+    } else {
+      if (opts->buffer_size > 0) {
+        setvbuf(file, NULL, _IOFBF, opts->buffer_size);
+      }
+      ret = write_png(&job, file);
+      if (fclose(file) != 0) {
+        perror("fclose");
+        ret = -1;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < job.nb_chunks; i++) {
+    free(job.chunks[i].out);
+  }
+  free(job.chunks);
+  return ret;
+}
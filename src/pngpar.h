@@ -0,0 +1,40 @@
+#ifndef INF3170_PNGPAR_H_
+#define INF3170_PNGPAR_H_
+
+#include <stddef.h>
+
+#include "image.h"
+#include "threadpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Écriture PNG dont la compression est répartie sur un pool, à la pigz.
+ *
+ * Les lignes filtrées sont découpées en tranches d'environ PNGPAR_CHUNK_SIZE
+ * octets, compressées indépendamment par les tâches du pool. Chaque tranche
+ * part du dictionnaire des 32 Kio qui la précèdent et se termine par un
+ * Z_SYNC_FLUSH, sur une frontière d'octet: leur concaténation forme un seul
+ * flux deflate, lisible par n'importe quel décodeur. L'Adler-32 du flux zlib
+ * est combiné à partir de ceux des tranches (adler32_combine).
+ *
+ * Les réglages sont ceux de image_save_png_opts(), à ceci près que le choix
+ * adaptatif des filtres (filters == -1 ou plusieurs filtres) est fait ligne
+ * par ligne avec l'heuristique de libpng, la somme minimale des différences.
+ * Sans pool, ou si l'image tient dans une tranche, l'image est écrite par
+ * image_save_png_opts().
+ */
+
+#define PNGPAR_CHUNK_SIZE ((size_t)1 << 20)
+
+// Retourne 0, ou -1 en cas d'erreur
+int pngpar_save(struct pool *pool, image_t *image, const char *filename,
+                const image_png_opts_t *opts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
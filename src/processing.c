@@ -1,61 +1,131 @@
 #include "processing.h"
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "bufpool.h"
 #include "filter.h"
 #include "image.h"
+#include "perfstat.h"
+#include "pngpar.h"
 #include "threadpool.h"
+#include "trace.h"
 
 typedef image_t* (*filter_fn)(image_t* img);
+typedef image_t* (*filter_mt_fn)(struct pool* pool, image_t* img);
 
-static const filter_fn filters[] = {
-    filter_scale_up2,      //
-    filter_desaturate,     //
-    filter_gaussian_blur,  //
-    filter_edge_detect,    //
-    NULL,                  //
+struct filter_step {
+  const char* name;  // nom dans les traces
+  filter_fn fn;
+  filter_mt_fn fn_mt;  // même filtre, lignes découpées sur un pool
 };
 
-// Fonction qui traite une image
-void* process_one_image(void* arg) {
-  struct work_item* item = arg;
+static const struct filter_step filters[] = {
+    {"scale_up2", filter_scale_up2, filter_scale_up2_mt},                     //
+    {"desaturate", filter_desaturate_inplace, filter_desaturate_inplace_mt},  //
+    {"gaussian_blur", filter_gaussian_blur, filter_gaussian_blur_mt},         //
+    {"edge_detect", filter_edge_detect, filter_edge_detect_mt},               //
+    {NULL, NULL, NULL},                                                       //
+};
+
+#define NB_FILTERS (sizeof(filters) / sizeof(filters[0]) - 1)
+
+// Étapes mesurées par perfstat: décodage, chaque filtre, encodage
+#define STAGE_DECODE 0
+#define STAGE_FILTER(i) (1 + (i))
+#define STAGE_ENCODE (1 + NB_FILTERS)
+
+// Taille minimale d'une image pour que découper ses lignes vaille la peine
+#define PROCESS_SPLIT_MIN_PIXELS (256 * 256)
+
+image_t* process_apply_filters(image_t* img, struct pool* pool) {
+  int i = 0;
+  while (filters[i].fn) {
+    struct perfstat_sample sample;
+    perfstat_begin(&sample);
+    trace_begin(TRACE_FILTER, filters[i].name);
+    image_t* next = pool ? filters[i].fn_mt(pool, img) : filters[i].fn(img);
+    trace_end(TRACE_FILTER, filters[i].name);
+    if (next) {
+      perfstat_end(STAGE_FILTER(i), filters[i].name, &sample,
+                   (uint64_t)next->width * next->height);
+    }
+    // Un filtre en place retourne son image
+    if (next != img) {
+      image_destroy(img);
+    }
+    if (!next) {
+      return NULL;
+    }
+    img = next;
+    i++;
+  }
+  return img;
+}
+
+// Traiter une image; si pool n'est pas NULL, les lignes de chaque filtre sont
+// réparties sur le pool, et si encode n'est pas NULL, la compression du fichier
+// de sortie l'est sur encode
+static int process_image(struct work_item* item, struct pool* pool,
+                         struct pool* encode) {
   const char* fname = item->input_file;
   printf("processing image: %s\n", fname);
 
+  struct perfstat_sample sample;
+  perfstat_begin(&sample);
+  trace_begin(TRACE_IO, "read_png");
   image_t* img = image_create_from_png(fname);
+  trace_end(TRACE_IO, "read_png");
   if (!img) {
     printf("failed to load image %s\n", fname);
     goto err;
   }
+  perfstat_end(STAGE_DECODE, "decode", &sample,
+               (uint64_t)img->width * img->height);
 
-  int i = 0;
-  while (filters[i]) {
-    filter_fn fn = filters[i];
-    image_t* next = fn(img);
-    if (!next) {
-      printf("failed to process image%s\n", fname);
-      image_destroy(img);
-      goto err;
-    }
-    image_destroy(img);
-    img = next;
-    i++;
+  img = process_apply_filters(img, pool);
+  if (!img) {
+    printf("failed to process image%s\n", fname);
+    goto err;
   }
-  image_save_png(img, item->output_file);
+  perfstat_begin(&sample);
+  trace_begin(TRACE_IO, "write_png");
+  int ret;
+  if (encode) {
+    image_png_opts_t png;
+    image_png_get_defaults(&png);
+    ret = pngpar_save(encode, img, item->output_file, &png);
+  } else {
+    ret = image_save_png(img, item->output_file);
+  }
+  trace_end(TRACE_IO, "write_png");
+  perfstat_end(STAGE_ENCODE, "encode", &sample,
+               (uint64_t)img->width * img->height);
   image_destroy(img);
+  if (ret < 0) {
+    printf("failed to save image %s\n", item->output_file);
+    goto err;
+  }
 
   return 0;
 err:
-  return (void*)-1UL;
+  return -1;
+}
+
+// Fonction qui traite une image
+void* process_one_image(void* arg) {
+  return process_image(arg, NULL, NULL) ? (void*)-1UL : 0;
 }
 
 int process_serial(struct list* items) {
   struct list_node* node = list_head(items);
   while (!list_end(node)) {
+    trace_begin(TRACE_TASK, "image");
     unsigned long ret = (unsigned long)process_one_image(node->data);
-    if (ret < 0) {
+    trace_end(TRACE_TASK, "image");
+    if (ret) {
       return -1;
     }
     node = node->next;
@@ -63,30 +133,298 @@ int process_serial(struct list* items) {
   return 0;
 }
 
-int process_multithread(struct list* items, int nb_thread) {
-  // Créer un pool de threads avec nb_thread threads
-  struct pool* pool = threadpool_create(nb_thread);
-  if (!pool) {
-    printf("Échec de la création du pool de threads\n");
+void process_opts_init(struct process_opts* opts) {
+  opts->split = PROCESS_SPLIT_AUTO;
+  opts->lpt = 0;
+  opts->affinity = THREADPOOL_AFFINITY_NONE;
+  opts->elastic = 0;
+  opts->memory_budget = 0;
+  opts->stats = 0;
+  opts->parallel_encode = 0;
+}
+
+/*
+ * Le coût d'une image est son nombre de pixels: chaque filtre fait un travail
+ * constant par pixel. Seul l'en-tête PNG est lu, l'image n'est pas décodée.
+ */
+int process_estimate_costs(struct list* items) {
+  int ret = 0;
+  struct list_node* node = list_head(items);
+  while (!list_end(node)) {
+    struct work_item* item = node->data;
+    size_t width = 0;
+    size_t height = 0;
+    if (item->cost == 0) {
+      if (image_png_size(item->input_file, &width, &height) == 0) {
+        item->cost = (uint64_t)width * height;
+      } else {
+        ret = -1;
+      }
+    }
+    node = node->next;
+  }
+  return ret;
+}
+
+size_t process_footprint(const struct work_item* item) {
+  return item->cost * PROCESS_BYTES_PER_PIXEL;
+}
+
+// Mémoire réservée par les images en cours de traitement
+struct process_budget {
+  size_t limit;
+  size_t used;
+  pthread_mutex_t lock;
+  pthread_cond_t released;
+};
+
+// Tampons gardés par la réserve (bufpool.h), comptés dans le budget
+static size_t budget_cached(void) {
+  struct bufpool_stats stats;
+  bufpool_get_stats(&stats);
+  return stats.cached_bytes;
+}
+
+// Attendre que bytes tiennent dans le budget avec les images en cours et les
+// tampons en réserve, quitte à vider la réserve; seule, une image est
+// toujours admise
+static void budget_acquire(struct process_budget* budget, size_t bytes) {
+  pthread_mutex_lock(&budget->lock);
+  int trimmed = 0;
+  while (budget->used + bytes + budget_cached() > budget->limit) {
+    if (!trimmed) {
+      bufpool_trim();
+      trimmed = 1;
+      continue;
+    }
+    if (budget->used == 0) {
+      break;
+    }
+    pthread_cond_wait(&budget->released, &budget->lock);
+    trimmed = 0;
+  }
+  budget->used += bytes;
+  pthread_mutex_unlock(&budget->lock);
+}
+
+static void budget_release(struct process_budget* budget, size_t bytes) {
+  pthread_mutex_lock(&budget->lock);
+  budget->used -= bytes;
+  pthread_cond_broadcast(&budget->released);
+  pthread_mutex_unlock(&budget->lock);
+}
+
+struct process_job {
+  struct work_item* item;
+  struct pool* split;   // pool sur lequel découper les lignes, ou NULL
+  struct pool* encode;  // pool sur lequel compresser la sortie, ou NULL
+  size_t index;         // position dans la liste, pour un tri stable
+  // Mémoire réservée par l'image, NULL sans limite de mémoire
+  struct process_budget* budget;
+  int* nb_failed;  // images du lot en échec, partagé par les tâches
+};
+
+static void* process_job_task(void* arg) {
+  struct process_job* job = arg;
+  int ret = process_image(job->item, job->split, job->encode);
+  if (job->budget) {
+    budget_release(job->budget, process_footprint(job->item));
+  }
+  if (ret) {
+    __atomic_add_fetch(job->nb_failed, 1, __ATOMIC_RELAXED);
+  }
+  return ret ? (void*)-1UL : 0;
+}
+
+static struct process_job* process_jobs_new(struct list* items) {
+  struct process_job* jobs = calloc(list_size(items), sizeof(*jobs));
+  if (!jobs) {
+    perror("malloc");
+    return NULL;
+  }
+
+  size_t i = 0;
+  struct list_node* node = list_head(items);
+  while (!list_end(node)) {
+    jobs[i].item = node->data;
+    jobs[i].index = i;
+    i++;
+    node = node->next;
+  }
+  return jobs;
+}
+
+// Coût décroissant, puis ordre de la liste
+static int job_cmp_cost(const void* a, const void* b) {
+  const struct process_job* ja = a;
+  const struct process_job* jb = b;
+  if (ja->item->cost != jb->item->cost) {
+    return ja->item->cost < jb->item->cost ? 1 : -1;
+  }
+  return ja->index < jb->index ? -1 : ja->index > jb->index;
+}
+
+int process_sort_by_cost(struct list* items) {
+  size_t nb_items = list_size(items);
+  struct process_job* jobs = process_jobs_new(items);
+  if (!jobs) {
     return -1;
   }
+  qsort(jobs, nb_items, sizeof(*jobs), job_cmp_cost);
 
-  // Ajouter toutes les images à la file d'attente des tâches
+  size_t i = 0;
   struct list_node* node = list_head(items);
   while (!list_end(node)) {
-    struct work_item* item = node->data;
-    threadpool_add_task(pool, process_one_image, item);
+    node->data = jobs[i++].item;
     node = node->next;
   }
+  free(jobs);
+  return 0;
+}
+
+/*
+ * Répartir les threads entre les images et les lignes d'une même image.
+ *
+ * Avec la seule répartition par image, une image plus grosse que sa part du
+ * lot (le total des pixels divisé par le nombre de threads) finit après les
+ * autres pendant que des threads restent inactifs: ses lignes sont alors
+ * découpées sur le pool. Un lot de petites images n'est jamais découpé.
+ *
+ * Les images découpées sont placées en tête pour démarrer en premier.
+ */
+static void process_plan(struct process_job* jobs, size_t nb_jobs,
+                         struct pool* pool, enum process_split split) {
+  // Une image illisible coûte zéro, son chargement échouera plus tard
+  uint64_t total = 0;
+  for (size_t i = 0; i < nb_jobs; i++) {
+    total += jobs[i].item->cost;
+  }
+
+  size_t nb_split = 0;
+  for (size_t i = 0; i < nb_jobs; i++) {
+    uint64_t cost = jobs[i].item->cost;
+    int do_split = split == PROCESS_SPLIT_ALWAYS;
+    if (split == PROCESS_SPLIT_AUTO) {
+      do_split = cost >= PROCESS_SPLIT_MIN_PIXELS &&
+                 cost * pool->nb_threads > total;
+    }
+    if (do_split) {
+      struct process_job job = jobs[i];
+      memmove(&jobs[nb_split + 1], &jobs[nb_split],
+              (i - nb_split) * sizeof(*jobs));
+      jobs[nb_split] = job;
+      jobs[nb_split++].split = pool;
+    }
+  }
+}
 
-  // Attendre que le traitement soit terminé
+// Traiter les images sur un pool existant, qui reste disponible ensuite
+int process_on_pool_opts(struct list* items, struct pool* pool,
+                         const struct process_opts* opts) {
+  size_t nb_items = list_size(items);
+  struct process_job* jobs = process_jobs_new(items);
+  void** args = malloc(nb_items * sizeof(void*));
+  if (!jobs || !args) {
+    perror("malloc");
+    free(jobs);
+    free(args);
+    return -1;
+  }
+
+  if (opts->lpt || opts->split == PROCESS_SPLIT_AUTO || opts->memory_budget) {
+    process_estimate_costs(items);
+  }
+  // Les plus grosses images d'abord: aucune ne reste seule à la fin du lot
+  if (opts->lpt) {
+    qsort(jobs, nb_items, sizeof(*jobs), job_cmp_cost);
+  }
+  process_plan(jobs, nb_items, pool, opts->split);
+  int nb_failed = 0;
+  for (size_t i = 0; i < nb_items; i++) {
+    jobs[i].nb_failed = &nb_failed;
+    if (opts->parallel_encode) {
+      jobs[i].encode = jobs[i].split;
+    }
+  }
+
+  if (opts->memory_budget) {
+    // Soumettre chaque image lorsque sa mémoire est disponible
+    struct process_budget budget = {.limit = opts->memory_budget, .used = 0};
+    pthread_mutex_init(&budget.lock, NULL);
+    pthread_cond_init(&budget.released, NULL);
+    for (size_t i = 0; i < nb_items; i++) {
+      jobs[i].budget = &budget;
+      budget_acquire(&budget, process_footprint(jobs[i].item));
+      // Une image refusée par le pool (pool borné plein, ou ENOMEM) est
+      // traitée ici; la tâche libère elle-même sa part du budget
+      if (threadpool_try_add_task(pool, process_job_task, &jobs[i]) != 0) {
+        process_job_task(&jobs[i]);
+      }
+    }
+    threadpool_wait(pool);
+    pthread_mutex_destroy(&budget.lock);
+    pthread_cond_destroy(&budget.released);
+    // Les tampons des dernières images ne restent pas au-delà du budget
+    if (budget_cached() > opts->memory_budget) {
+      bufpool_trim();
+    }
+  } else {
+    // Ajouter toutes les images à la file d'attente des tâches en un seul lot
+    for (size_t i = 0; i < nb_items; i++) {
+      args[i] = &jobs[i];
+    }
+    threadpool_add_tasks(pool, process_job_task, args, nb_items);
+    threadpool_wait(pool);
+  }
+  free(args);
+  free(jobs);
+
+  return __atomic_load_n(&nb_failed, __ATOMIC_RELAXED) ? -1 : 0;
+}
+
+int process_on_pool(struct list* items, struct pool* pool) {
+  struct process_opts opts;
+  process_opts_init(&opts);
+  return process_on_pool_opts(items, pool, &opts);
+}
+
+int process_multithread_opts(struct list* items, int nb_thread,
+                             const struct process_opts* opts) {
+  // Créer un pool de threads avec nb_thread threads; le vol de tâches fait
+  // passer les tranches des images découpées avant les images suivantes
+  struct pool_attr attr;
+  threadpool_attr_init(&attr, nb_thread);
+  attr.work_stealing = 1;
+  attr.affinity = opts->affinity;
+  if (opts->elastic) {
+    attr.nb_threads = 1;
+    attr.max_threads = nb_thread;
+  }
+  attr.stats = opts->stats;
+  struct pool* pool = threadpool_create_attr(&attr);
+  if (!pool) {
+    printf("Échec de la création du pool de threads\n");
+    return -1;
+  }
+
+  int ret = process_on_pool_opts(items, pool, opts);
+  if (opts->stats) {
+    threadpool_stats_print(stdout, pool);
+    bufpool_stats_print(stdout);
+  }
   threadpool_join(pool);
 
-  return 0;
+  return ret;
+}
+
+int process_multithread(struct list* items, int nb_thread) {
+  struct process_opts opts;
+  process_opts_init(&opts);
+  return process_multithread_opts(items, nb_thread, &opts);
 }
 
 struct work_item* make_work_item(const char* input_file, const char* output_dir) {
-  struct work_item* item = malloc(sizeof(struct work_item));
+  struct work_item* item = calloc(1, sizeof(struct work_item));
   item->input_file = strdup(input_file);
   item->output_file = strdup(output_dir);
   return item;
@@ -5,7 +5,9 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include "image.h"
 #include "list.h"
+#include "threadpool.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,11 +16,93 @@ extern "C" {
 struct work_item {
   char *input_file;
   char *output_file;
+  uint64_t cost;  // coût estimé du traitement, 0 si inconnu
 };
 
 void free_work_item(void *item);
 
+/*
+ * Appliquer la chaîne de filtres à img, qui est libérée. Si pool n'est pas
+ * NULL, les lignes de chaque filtre sont réparties sur le pool. Retourne la
+ * nouvelle image, ou NULL en cas d'erreur.
+ */
+image_t *process_apply_filters(image_t *img, struct pool *pool);
+
+/*
+ * Estimer le coût des éléments dont le coût est inconnu à partir de l'en-tête
+ * PNG (largeur x hauteur), sans décoder les images. Retourne -1 si un en-tête
+ * n'a pas pu être lu; le coût de cet élément reste à 0.
+ */
+int process_estimate_costs(struct list *items);
+
+// Trier la liste par coût décroissant; l'ordre des coûts égaux est conservé
+int process_sort_by_cost(struct list *items);
+
+/*
+ * Répartition des threads entre les images et les lignes de chaque image.
+ *
+ * PROCESS_SPLIT_AUTO lit les dimensions de chaque image dans son en-tête PNG et
+ * découpe les lignes des images plus grosses que leur part du lot, par exemple
+ * quelques très grandes images sur beaucoup de coeurs. Un lot de vignettes est
+ * traité une image par tâche.
+ */
+enum process_split {
+  PROCESS_SPLIT_AUTO,
+  PROCESS_SPLIT_NEVER,   // une image par tâche
+  PROCESS_SPLIT_ALWAYS,  // les lignes de chaque image sont découpées
+};
+
+/*
+ * Mémoire occupée par une image pendant son traitement, par pixel de l'image
+ * source: filter_scale_up2 produit quatre pixels par pixel source, et chaque
+ * filtre garde son entrée et sa sortie en même temps.
+ */
+#define PROCESS_BYTES_PER_PIXEL (2 * 4 * sizeof(pixel_t))
+
+// Empreinte mémoire estimée du traitement d'un élément dont le coût est connu
+size_t process_footprint(const struct work_item *item);
+
+/*
+ * lpt: soumettre les images par coût décroissant (longest processing time
+ * first), pour qu'une grosse image en fin de lot ne retarde pas tout le lot.
+ *
+ * memory_budget: si non nul, une image n'est soumise que lorsque son empreinte
+ * (process_footprint) tient dans le budget avec celles des images en cours. Les
+ * images sont admises dans l'ordre de soumission; une image plus grosse que le
+ * budget est traitée seule. Les tampons gardés par la réserve (bufpool.h)
+ * comptent dans le budget: elle est vidée quand une image ne tiendrait pas
+ * autrement, et ne garde pas plus de memory_budget octets après le lot.
+ *
+ * elastic: le pool créé par process_multithread_opts démarre avec un seul
+ * travailleur et grandit jusqu'à nb_thread selon la charge.
+ *
+ * stats: process_multithread_opts compte l'activité de ses travailleurs et
+ * l'affiche sur stdout avant de détruire le pool (threadpool_stats_print).
+ *
+ * parallel_encode: la compression d'une image découpée est aussi répartie sur
+ * le pool (pngpar.h). Le fichier écrit n'est alors plus identique octet pour
+ * octet à celui du traitement séquentiel, seuls ses pixels le sont.
+ */
+struct process_opts {
+  enum process_split split;
+  int lpt;
+  enum threadpool_affinity affinity;  // pool créé par process_multithread_opts
+  int elastic;
+  size_t memory_budget;  // octets, 0 sans limite
+  int stats;
+  int parallel_encode;
+};
+
+void process_opts_init(struct process_opts *opts);
+
+// Retournent -1 si une image n'a pas pu être lue, traitée ou écrite; les
+// autres images du lot sont quand même traitées, sauf par process_serial
 int process_multithread(struct list *items, int nb_thread);
+int process_multithread_opts(struct list *items, int nb_thread,
+                             const struct process_opts *opts);
+int process_on_pool(struct list *items, struct pool *pool);
+int process_on_pool_opts(struct list *items, struct pool *pool,
+                         const struct process_opts *opts);
 int process_serial(struct list *items);
 
 #ifdef __cplusplus
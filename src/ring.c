@@ -0,0 +1,144 @@
+#include "ring.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// La capacité est arrondie à la puissance de deux supérieure
+struct ring* ring_new(size_t capacity) {
+  size_t size = 2;
+  while (size < capacity) {
+    size *= 2;
+  }
+
+  struct ring* r = aligned_alloc(CACHELINE_SIZE, sizeof(*r));
+  if (!r) {
+    perror("ring_new()");
+    return NULL;
+  }
+  r->cells = aligned_alloc(CACHELINE_SIZE, size * sizeof(struct ring_cell));
+  if (!r->cells) {
+    perror("ring_new()");
+    free(r);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < size; i++) {
+    r->cells[i].seq = i;
+    r->cells[i].data = NULL;
+  }
+  r->mask = size - 1;
+  r->enqueue_pos = 0;
+  r->dequeue_pos = 0;
+  return r;
+}
+
+void ring_free(struct ring* r) {
+  if (!r) {
+    return;
+  }
+  free(r->cells);
+  free(r);
+}
+
+// Retourne -1 si la file est pleine
+int ring_push(struct ring* r, void* item) {
+  size_t pos = __atomic_load_n(&r->enqueue_pos, __ATOMIC_RELAXED);
+  struct ring_cell* cell;
+
+  while (1) {
+    cell = &r->cells[pos & r->mask];
+    size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&r->enqueue_pos, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return -1;
+    } else {
+      pos = __atomic_load_n(&r->enqueue_pos, __ATOMIC_RELAXED);
+    }
+  }
+
+  cell->data = item;
+  __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+// Réserver jusqu'à n cases consécutives avec un seul CAS. Retourne le nombre
+// d'éléments ajoutés, 0 si la file est pleine.
+size_t ring_push_n(struct ring* r, void* const* items, size_t n) {
+  size_t pos = __atomic_load_n(&r->enqueue_pos, __ATOMIC_RELAXED);
+  size_t k;
+
+  while (1) {
+    int stale = 0;
+    for (k = 0; k < n; k++) {
+      struct ring_cell* cell = &r->cells[(pos + k) & r->mask];
+      size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + k);
+      if (diff < 0) {
+        break;
+      }
+      if (diff > 0) {
+        // Un autre producteur a déjà réservé cette case: pos est périmé
+        stale = 1;
+        break;
+      }
+    }
+
+    if (stale) {
+      pos = __atomic_load_n(&r->enqueue_pos, __ATOMIC_RELAXED);
+    } else if (k == 0) {
+      return 0;
+    } else if (__atomic_compare_exchange_n(&r->enqueue_pos, &pos, pos + k, 1,
+                                           __ATOMIC_RELAXED,
+                                           __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+
+  for (size_t i = 0; i < k; i++) {
+    struct ring_cell* cell = &r->cells[(pos + i) & r->mask];
+    cell->data = items[i];
+    __atomic_store_n(&cell->seq, pos + i + 1, __ATOMIC_RELEASE);
+  }
+  return k;
+}
+
+// Retourne NULL si la file est vide
+void* ring_pop(struct ring* r) {
+  size_t pos = __atomic_load_n(&r->dequeue_pos, __ATOMIC_RELAXED);
+  struct ring_cell* cell;
+
+  while (1) {
+    cell = &r->cells[pos & r->mask];
+    size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+    intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&r->dequeue_pos, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return NULL;
+    } else {
+      pos = __atomic_load_n(&r->dequeue_pos, __ATOMIC_RELAXED);
+    }
+  }
+
+  void* item = cell->data;
+  __atomic_store_n(&cell->seq, pos + r->mask + 1, __ATOMIC_RELEASE);
+  return item;
+}
+
+size_t ring_capacity(struct ring* r) { return r->mask + 1; }
+
+// Approximatif lorsque d'autres threads modifient la file
+size_t ring_size(struct ring* r) {
+  size_t tail = __atomic_load_n(&r->enqueue_pos, __ATOMIC_SEQ_CST);
+  size_t head = __atomic_load_n(&r->dequeue_pos, __ATOMIC_SEQ_CST);
+  return tail > head ? tail - head : 0;
+}
@@ -0,0 +1,47 @@
+#ifndef INF3170_RING_H_
+#define INF3170_RING_H_
+
+#include <stddef.h>
+
+#include "cpu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * File MPMC bornée sans verrou (D. Vyukov).
+ *
+ * Chaque case porte un numéro de séquence qui indique si elle est libre pour le
+ * producteur du tour courant ou pleine pour le consommateur. Les positions
+ * d'enfilage et de défilage sont sur des lignes de cache distinctes pour que
+ * producteurs et consommateurs ne se les disputent pas.
+ */
+
+struct ring_cell {
+  size_t seq;
+  void* data;
+};
+
+struct ring {
+  struct ring_cell* cells;
+  size_t mask;
+  size_t enqueue_pos CACHELINE_ALIGNED;
+  size_t dequeue_pos CACHELINE_ALIGNED;
+} CACHELINE_ALIGNED;
+
+struct ring* ring_new(size_t capacity);
+void ring_free(struct ring* r);
+
+int ring_push(struct ring* r, void* item);
+size_t ring_push_n(struct ring* r, void* const* items, size_t n);
+void* ring_pop(struct ring* r);
+
+size_t ring_capacity(struct ring* r);
+size_t ring_size(struct ring* r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
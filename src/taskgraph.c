@@ -0,0 +1,224 @@
+#include "taskgraph.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct taskgraph_node {
+  struct taskgraph* graph;
+  func_t fn;
+  void* arg;
+  void* result;
+  size_t nb_preds;
+  size_t pending;  // prédécesseurs pas encore terminés pendant une exécution
+  struct taskgraph_node** succs;
+  size_t nb_succs;
+  size_t succs_capacity;
+};
+
+struct taskgraph {
+  struct pool* pool;
+  struct taskgraph_node** nodes;
+  size_t nb_nodes;
+  size_t capacity;
+
+  size_t remaining;  // noeuds pas encore terminés
+  int done;
+  pthread_mutex_t lock;
+  pthread_cond_t finished;
+};
+
+// Doubler la capacité d'un tableau de noeuds plein
+static int grow(struct taskgraph_node*** items, size_t* capacity) {
+  size_t n = *capacity ? *capacity * 2 : 4;
+  struct taskgraph_node** tmp = realloc(*items, n * sizeof(**items));
+  if (!tmp) {
+    perror("realloc");
+    return -1;
+  }
+  *items = tmp;
+  *capacity = n;
+  return 0;
+}
+
+struct taskgraph* taskgraph_new(struct pool* pool) {
+  struct taskgraph* graph = calloc(1, sizeof(struct taskgraph));
+  if (!graph) {
+    perror("calloc");
+    return NULL;
+  }
+  graph->pool = pool;
+  pthread_mutex_init(&graph->lock, NULL);
+  pthread_cond_init(&graph->finished, NULL);
+  return graph;
+}
+
+void taskgraph_free(struct taskgraph* graph) {
+  if (!graph) {
+    return;
+  }
+  for (size_t i = 0; i < graph->nb_nodes; i++) {
+    free(graph->nodes[i]->succs);
+    free(graph->nodes[i]);
+  }
+  free(graph->nodes);
+  pthread_mutex_destroy(&graph->lock);
+  pthread_cond_destroy(&graph->finished);
+  free(graph);
+}
+
+struct taskgraph_node* taskgraph_add(struct taskgraph* graph, func_t fn,
+                                     void* arg) {
+  if (graph->nb_nodes == graph->capacity &&
+      grow(&graph->nodes, &graph->capacity) < 0) {
+    return NULL;
+  }
+  struct taskgraph_node* node = calloc(1, sizeof(struct taskgraph_node));
+  if (!node) {
+    perror("calloc");
+    return NULL;
+  }
+  node->graph = graph;
+  node->fn = fn;
+  node->arg = arg;
+  graph->nodes[graph->nb_nodes++] = node;
+  return node;
+}
+
+int taskgraph_edge(struct taskgraph* graph, struct taskgraph_node* from,
+                   struct taskgraph_node* to) {
+  if (from->graph != graph || to->graph != graph) {
+    return -1;
+  }
+  if (from->nb_succs == from->succs_capacity &&
+      grow(&from->succs, &from->succs_capacity) < 0) {
+    return -1;
+  }
+  from->succs[from->nb_succs++] = to;
+  to->nb_preds++;
+  return 0;
+}
+
+// Vrai si le graphe est acyclique: tri topologique de Kahn sur les compteurs
+// pending, qui sont ensuite remis à nb_preds
+static int taskgraph_acyclic(struct taskgraph* graph) {
+  struct taskgraph_node** ready =
+      malloc((graph->nb_nodes ? graph->nb_nodes : 1) * sizeof(*ready));
+  if (!ready) {
+    perror("malloc");
+    return 0;
+  }
+
+  size_t head = 0;
+  size_t tail = 0;
+  for (size_t i = 0; i < graph->nb_nodes; i++) {
+    struct taskgraph_node* node = graph->nodes[i];
+    node->pending = node->nb_preds;
+    if (node->pending == 0) {
+      ready[tail++] = node;
+    }
+  }
+  while (head < tail) {
+    struct taskgraph_node* node = ready[head++];
+    for (size_t i = 0; i < node->nb_succs; i++) {
+      if (--node->succs[i]->pending == 0) {
+        ready[tail++] = node->succs[i];
+      }
+    }
+  }
+
+  for (size_t i = 0; i < graph->nb_nodes; i++) {
+    graph->nodes[i]->pending = graph->nodes[i]->nb_preds;
+  }
+  free(ready);
+  return tail == graph->nb_nodes;
+}
+
+static void taskgraph_node_done(struct taskgraph* graph) {
+  if (__atomic_sub_fetch(&graph->remaining, 1, __ATOMIC_ACQ_REL) == 0) {
+    pthread_mutex_lock(&graph->lock);
+    graph->done = 1;
+    pthread_cond_broadcast(&graph->finished);
+    pthread_mutex_unlock(&graph->lock);
+  }
+}
+
+// Exécuter un noeud, puis en continuation le premier successeur devenu prêt
+static void* taskgraph_node_task(void* arg) {
+  struct taskgraph_node* node = arg;
+  struct taskgraph* graph = node->graph;
+
+  while (node) {
+    node->result = node->fn(node->arg);
+
+    struct taskgraph_node* next = NULL;
+    for (size_t i = 0; i < node->nb_succs; i++) {
+      struct taskgraph_node* succ = node->succs[i];
+      if (__atomic_sub_fetch(&succ->pending, 1, __ATOMIC_ACQ_REL) != 0) {
+        continue;
+      }
+      if (!next) {
+        next = succ;
+      } else {
+        threadpool_add_task(graph->pool, taskgraph_node_task, succ);
+      }
+    }
+    // Le graphe peut être libéré dès le dernier noeud terminé
+    taskgraph_node_done(graph);
+    node = next;
+  }
+  return NULL;
+}
+
+int taskgraph_submit(struct taskgraph* graph) {
+  if (!taskgraph_acyclic(graph)) {
+    return -1;
+  }
+
+  void** roots = malloc((graph->nb_nodes ? graph->nb_nodes : 1) *
+                        sizeof(void*));
+  if (!roots) {
+    perror("malloc");
+    return -1;
+  }
+  graph->remaining = graph->nb_nodes;
+  graph->done = graph->nb_nodes == 0;
+
+  // Soumettre les racines en un seul lot: la première peut terminer tout le
+  // graphe avant que les suivantes soient parcourues
+  size_t nb_roots = 0;
+  for (size_t i = 0; i < graph->nb_nodes; i++) {
+    struct taskgraph_node* node = graph->nodes[i];
+    node->result = NULL;
+    if (node->nb_preds == 0) {
+      roots[nb_roots++] = node;
+    }
+  }
+  threadpool_add_tasks(graph->pool, taskgraph_node_task, roots, nb_roots);
+  free(roots);
+  return 0;
+}
+
+void taskgraph_wait(struct taskgraph* graph) {
+  pthread_mutex_lock(&graph->lock);
+  while (!graph->done) {
+    pthread_cond_wait(&graph->finished, &graph->lock);
+  }
+  pthread_mutex_unlock(&graph->lock);
+}
+
+int taskgraph_run(struct taskgraph* graph) {
+  if (taskgraph_submit(graph) < 0) {
+    return -1;
+  }
+  taskgraph_wait(graph);
+  return 0;
+}
+
+void* taskgraph_result(struct taskgraph_node* node) {
+  return node->result;
+}
+
+size_t taskgraph_size(struct taskgraph* graph) {
+  return graph->nb_nodes;
+}
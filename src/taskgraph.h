@@ -0,0 +1,60 @@
+#ifndef INF3170_TASKGRAPH_H_
+#define INF3170_TASKGRAPH_H_
+
+#include <stddef.h>
+
+#include "threadpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Graphe de tâches exécuté sur un pool.
+ *
+ * Un noeud fn(arg) devient prêt lorsque tous ses prédécesseurs sont terminés.
+ * Le travailleur qui termine un noeud exécute lui-même le premier successeur
+ * devenu prêt, pendant que les données produites sont encore dans son cache;
+ * les autres successeurs prêts sont soumis au pool. Les noeuds sans
+ * prédécesseur sont soumis au démarrage.
+ *
+ * Le graphe peut être exécuté plusieurs fois, mais pas modifié pendant une
+ * exécution. taskgraph_wait() ne doit pas être appelée depuis une tâche du
+ * pool.
+ */
+
+struct taskgraph;
+struct taskgraph_node;
+
+struct taskgraph *taskgraph_new(struct pool *pool);
+void taskgraph_free(struct taskgraph *graph);
+
+// Retourne NULL si l'allocation échoue
+struct taskgraph_node *taskgraph_add(struct taskgraph *graph, func_t fn,
+                                     void *arg);
+
+// to ne démarre qu'après from. Retourne -1 si l'allocation échoue ou si un des
+// noeuds appartient à un autre graphe.
+int taskgraph_edge(struct taskgraph *graph, struct taskgraph_node *from,
+                   struct taskgraph_node *to);
+
+/*
+ * Soumettre les noeuds sans prédécesseur. Retourne -1, sans rien exécuter, si
+ * le graphe contient un cycle ou si l'allocation échoue.
+ */
+int taskgraph_submit(struct taskgraph *graph);
+void taskgraph_wait(struct taskgraph *graph);
+
+// taskgraph_submit() puis taskgraph_wait()
+int taskgraph_run(struct taskgraph *graph);
+
+// Valeur de retour de fn lors de la dernière exécution
+void *taskgraph_result(struct taskgraph_node *node);
+
+size_t taskgraph_size(struct taskgraph *graph);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
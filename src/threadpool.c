@@ -1,53 +1,942 @@
+#define _GNU_SOURCE
 #include "threadpool.h"
+#include <errno.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
 #include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "filter.h"
 #include "threadpool.h"
+#include "trace.h"
 
-// Fonction exécutée par chaque thread travailleur
-void* worker(void* arg) {
-  struct worker_arg* w = arg;
-  struct pool* pool = w->pool;
+// Nombre maximal de tâches transférées de la file partagée vers une deque
+#define STEAL_BATCH 32
+#define RING_DEFAULT_CAPACITY 4096
+// Bornes de l'attente active adaptative et nombre de sched_yield() avant de
+// s'endormir, THREADPOOL_IDLE_SPIN
+#define SPIN_MIN 16
+#define IDLE_YIELDS 4
+// Attente maximale d'un thread dans taskgroup_wait() avant de chercher à
+// nouveau une tâche à exécuter
+#define HELP_SLEEP_NS 1000000
 
-  // Attendre que tous les threads démarrent
-  pthread_barrier_wait(&pool->ready);
+// Travailleur courant, NULL si le thread n'appartient à aucun pool
+static __thread struct worker_arg* current_worker;
 
-  // Boucle principale du thread travailleur
+void* worker(void* arg);
+
+static inline int is_pool_worker(struct pool* pool) {
+  return current_worker && current_worker->pool == pool;
+}
+
+// timeout est relatif, NULL pour attendre indéfiniment
+static inline void futex_wait(uint32_t* addr, uint32_t val,
+                              const struct timespec* timeout) {
+  syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, timeout, NULL, 0);
+}
+
+static inline void futex_wake(uint32_t* addr, int n) {
+  syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+static inline int64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline struct timespec ns_to_timespec(int64_t ns) {
+  struct timespec ts = {.tv_sec = ns / 1000000000LL,
+                        .tv_nsec = ns % 1000000000LL};
+  return ts;
+}
+
+// Case de l'histogramme pour une durée de ns nanosecondes
+static inline int hist_bucket(uint64_t ns) {
+  int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+  return bucket < THREADPOOL_HIST_BUCKETS ? bucket
+                                          : THREADPOOL_HIST_BUCKETS - 1;
+}
+
+// Ajouter v à un compteur. Ceux d'un travailleur n'ont qu'un seul écrivain et
+// se passent d'instruction atomique; extern_stats est partagé.
+static inline void stat_add(uint64_t* counter, uint64_t v, int shared) {
+  if (shared) {
+    __atomic_add_fetch(counter, v, __ATOMIC_RELAXED);
+  } else {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + v,
+                     __ATOMIC_RELAXED);
+  }
+}
+
+static inline unsigned int xorshift32(unsigned int* state) {
+  unsigned int x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+struct task_slab {
+  struct task_slab* next;
+  struct task tasks[THREADPOOL_TASK_SLAB];
+};
+
+// Ajouter un bloc de tâches à la liste libre du pool (pool->free_lock tenu)
+static int task_slab_new(struct pool* pool) {
+  struct task_slab* slab = malloc(sizeof(struct task_slab));
+  if (!slab) {
+    perror("Échec de l'allocation d'un bloc de tâches");
+    return -1;
+  }
+  __atomic_add_fetch(&pool->task_allocs, 1, __ATOMIC_RELAXED);
+
+  for (int i = 0; i < THREADPOOL_TASK_SLAB; i++) {
+    struct task* task = &slab->tasks[i];
+    task->node.sentinel = false;
+    task->node.data = task;
+    task->next = pool->free_tasks;
+    pool->free_tasks = task;
+  }
+  slab->next = pool->slabs;
+  pool->slabs = slab;
+  return 0;
+}
+
+static inline struct task* task_list_move(struct task** from,
+                                          struct task** to) {
+  struct task* task = *from;
+  *from = task->next;
+  task->next = *to;
+  *to = task;
+  return task;
+}
+
+// Obtenir n tâches libres chaînées par next: le cache du travailleur d'abord,
+// sinon la liste du pool, qui grandit d'un bloc lorsqu'elle est vide. Une
+// seule prise de verrou suffit pour tout le lot.
+static struct task* task_alloc_n(struct pool* pool, size_t n) {
+  struct worker_arg* w = is_pool_worker(pool) ? current_worker : NULL;
+  struct task* chain = NULL;
+  size_t got = 0;
+
+  while (w && w->free_tasks && got < n) {
+    task_list_move(&w->free_tasks, &chain);
+    w->nb_free--;
+    got++;
+  }
+  if (got == n) {
+    return chain;
+  }
+
+  pthread_mutex_lock(&pool->free_lock);
+  while (got < n) {
+    if (!pool->free_tasks && task_slab_new(pool) < 0) {
+      // Rendre le lot partiel
+      while (chain) {
+        task_list_move(&chain, &pool->free_tasks);
+      }
+      pthread_mutex_unlock(&pool->free_lock);
+      return NULL;
+    }
+    task_list_move(&pool->free_tasks, &chain);
+    got++;
+  }
+
+  // Un travailleur remplit son cache pour les prochaines sous-tâches
+  if (w) {
+    while (pool->free_tasks && w->nb_free < THREADPOOL_TASK_CACHE / 2) {
+      task_list_move(&pool->free_tasks, &w->free_tasks);
+      w->nb_free++;
+    }
+  }
+  pthread_mutex_unlock(&pool->free_lock);
+  return chain;
+}
+
+// Rendre au pool une chaîne de tâches jamais exécutées
+static void task_free_chain(struct pool* pool, struct task* chain) {
+  pthread_mutex_lock(&pool->free_lock);
+  while (chain) {
+    task_list_move(&chain, &pool->free_tasks);
+  }
+  pthread_mutex_unlock(&pool->free_lock);
+}
+
+static void task_free(struct pool* pool, struct task* task) {
+  struct worker_arg* w = is_pool_worker(pool) ? current_worker : NULL;
+
+  if (!w) {
+    pthread_mutex_lock(&pool->free_lock);
+    task->next = pool->free_tasks;
+    pool->free_tasks = task;
+    pthread_mutex_unlock(&pool->free_lock);
+    return;
+  }
+
+  task->next = w->free_tasks;
+  w->free_tasks = task;
+  if (++w->nb_free < THREADPOOL_TASK_CACHE) {
+    return;
+  }
+
+  // Cache plein: rendre la moitié au pool en une seule prise de verrou
+  struct task* first = w->free_tasks;
+  struct task* last = first;
+  for (int i = 1; i < THREADPOOL_TASK_CACHE / 2; i++) {
+    last = last->next;
+  }
+  w->free_tasks = last->next;
+  w->nb_free -= THREADPOOL_TASK_CACHE / 2;
+
+  pthread_mutex_lock(&pool->free_lock);
+  last->next = pool->free_tasks;
+  pool->free_tasks = first;
+  pthread_mutex_unlock(&pool->free_lock);
+}
+
+// Prendre pool->lock. Avec les statistiques, un travailleur compte le temps
+// d'attente du verrou lorsqu'il est déjà pris.
+static inline void pool_lock(struct pool* pool) {
+  if (!pool->stats || !is_pool_worker(pool)) {
+    pthread_mutex_lock(&pool->lock);
+    return;
+  }
+  struct threadpool_stats* s = &current_worker->stats;
+  stat_add(&s->lock_acquires, 1, 0);
+  if (pthread_mutex_trylock(&pool->lock) == 0) {
+    return;
+  }
+  int64_t start = now_ns();
+  pthread_mutex_lock(&pool->lock);
+  stat_add(&s->lock_ns, now_ns() - start, 0);
+}
+
+// Réveiller les threads bloqués dans threadpool_wait() ou future_get(), sans
+// prendre le verrou si personne n'attend
+static void pool_wake_waiters(struct pool* pool) {
+  if (__atomic_load_n(&pool->nb_waiters, __ATOMIC_SEQ_CST) == 0) {
+    return;
+  }
+  pthread_mutex_lock(&pool->lock);
+  pthread_cond_broadcast(&pool->work_done);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static void pool_tasks_done(struct pool* pool, size_t n) {
+  size_t left = __atomic_sub_fetch(&pool->nb_pending, n, __ATOMIC_SEQ_CST);
+  if (left == 0) {
+    pool_wake_waiters(pool);
+  }
+  // Pool borné: réveiller les producteurs qui attendent une place
+  if (pool->max_pending && left < pool->max_pending &&
+      __atomic_load_n(&pool->nb_blocked, __ATOMIC_SEQ_CST) > 0) {
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_broadcast(&pool->room);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+// Vrai si n tâches de plus tiennent dans le pool borné. Un lot plus grand que
+// la borne est admis lorsque le pool est vide.
+static inline int pool_has_room(struct pool* pool, size_t pending, size_t n) {
+  return pending == 0 || pending + n <= pool->max_pending;
+}
+
+// Compter n tâches de plus dans nb_pending. Avec max_pending, attendre qu'il y
+// ait de la place si block est vrai, sinon retourner EAGAIN. Un travailleur
+// n'attend jamais: ses pairs pourraient tous attendre comme lui.
+static int pool_reserve(struct pool* pool, size_t n, int block) {
+  if (!pool->max_pending || is_pool_worker(pool)) {
+    __atomic_add_fetch(&pool->nb_pending, n, __ATOMIC_SEQ_CST);
+    return 0;
+  }
+
+  size_t pending = __atomic_load_n(&pool->nb_pending, __ATOMIC_SEQ_CST);
   while (1) {
+    if (pool_has_room(pool, pending, n)) {
+      if (__atomic_compare_exchange_n(&pool->nb_pending, &pending, pending + n,
+                                      0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        return 0;
+      }
+      continue;
+    }
+    if (!block) {
+      return EAGAIN;
+    }
+
     pthread_mutex_lock(&pool->lock);
+    __atomic_add_fetch(&pool->nb_blocked, 1, __ATOMIC_SEQ_CST);
+    while (!pool_has_room(
+        pool, __atomic_load_n(&pool->nb_pending, __ATOMIC_SEQ_CST), n)) {
+      pthread_cond_wait(&pool->room, &pool->lock);
+    }
+    __atomic_sub_fetch(&pool->nb_blocked, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pool->lock);
+    pending = __atomic_load_n(&pool->nb_pending, __ATOMIC_SEQ_CST);
+  }
+}
 
-    // Attendre qu'une tâche soit ajoutée ou que le pool cesse de fonctionner
-    while (list_empty(pool->task_list) && pool->running) {
-      pthread_cond_wait(&pool->work_todo, &pool->lock);
+// Compter une tâche exécutée par le thread appelant
+static void task_account(struct pool* pool, uint64_t wait, uint64_t exec) {
+  int shared = !is_pool_worker(pool);
+  struct threadpool_stats* s =
+      shared ? &pool->extern_stats : &current_worker->stats;
+  stat_add(&s->nb_tasks, 1, shared);
+  stat_add(&s->busy_ns, exec, shared);
+  stat_add(&s->wait_hist[hist_bucket(wait)], 1, shared);
+  stat_add(&s->exec_hist[hist_bucket(exec)], 1, shared);
+}
+
+static inline void run_task(struct pool* pool, struct task* task) {
+  struct future* future = task->future;
+  struct taskgroup* group = task->group;
+  int64_t start = pool->stats ? now_ns() : 0;
+  int64_t submitted = task->submitted_ns;
+  trace_begin(TRACE_TASK, "task");
+  void* result = task->func(task->arg);
+  trace_end(TRACE_TASK, "task");
+  task_free(pool, task);
+  if (pool->stats) {
+    int64_t end = now_ns();
+    task_account(pool, start - submitted, end - start);
+  }
+  // La future et le groupe sont libérés par leur propriétaire dès que done ou
+  // pending est visible
+  if (future) {
+    future->result = result;
+    __atomic_store_n(&future->done, 1, __ATOMIC_SEQ_CST);
+    pool_wake_waiters(pool);
+  }
+  if (group && __atomic_sub_fetch(&group->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+    pool_wake_waiters(pool);
+  }
+  pool_tasks_done(pool, 1);
+}
+
+// Nombre de tâches dans une file partagée, sans verrou
+static inline size_t lane_size(struct pool* pool, struct pool_lane* lane) {
+  if (pool->queue == THREADPOOL_QUEUE_RING) {
+    return ring_size(lane->ring);
+  }
+  return __atomic_load_n(&lane->nb_tasks, __ATOMIC_RELAXED);
+}
+
+// Noeud dont le thread appelant utilise les files
+static int caller_node(struct pool* pool) {
+  if (is_pool_worker(pool)) {
+    return current_worker->node;
+  }
+  if (pool->nb_nodes == 1) {
+    return 0;
+  }
+  return topology_cpu_node(&pool->topology, sched_getcpu());
+}
+
+// Vrai s'il reste une tâche en attente quelque part. Peut être appelée sans
+// pool->lock, le résultat est alors approximatif. Parcourt toutes les files et
+// toutes les deques: à éviter dans une boucle d'attente active.
+static int pool_has_work(struct pool* pool) {
+  for (int node = 0; node < pool->nb_nodes; node++) {
+    for (int p = 0; p < THREADPOOL_NB_PRIO; p++) {
+      if (lane_size(pool, &pool->nodes[node].lanes[p]) > 0) {
+        return 1;
+      }
+    }
+  }
+  if (pool->work_stealing) {
+    for (int i = 0; i < pool->nb_threads; i++) {
+      if (deque_size(&pool->args[i].deque) > 0) {
+        return 1;
+      }
     }
+  }
+  return 0;
+}
 
-    // Si le pool ne fonctionne pas et que la liste des tâches est vide, sortir de la boucle
-    if (!pool->running && list_empty(pool->task_list)) {
-      pthread_mutex_unlock(&pool->lock);
+// Réveiller min(n, nb_idle) travailleurs (pool->lock tenu)
+static void pool_wake_locked(struct pool* pool, size_t n) {
+  size_t idle = __atomic_load_n(&pool->nb_idle, __ATOMIC_RELAXED);
+  if (n >= idle) {
+    pthread_cond_broadcast(&pool->work_todo);
+    return;
+  }
+  for (size_t i = 0; i < n; i++) {
+    pthread_cond_signal(&pool->work_todo);
+  }
+}
+
+// Réveiller jusqu'à n travailleurs endormis sur le futex
+static void pool_wake_futex(struct pool* pool, size_t n) {
+  __atomic_add_fetch(&pool->epoch, 1, __ATOMIC_SEQ_CST);
+  futex_wake(&pool->epoch, n < INT_MAX ? n : INT_MAX);
+}
+
+// Réveiller jusqu'à n travailleurs endormis, sans appel système si aucun ne
+// dort. Les travailleurs en attente active voient epoch changer.
+static void pool_notify(struct pool* pool, size_t n) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int idle = __atomic_load_n(&pool->nb_idle, __ATOMIC_RELAXED);
+  if (pool->idle == THREADPOOL_IDLE_SPIN) {
+    if (idle > 0) {
+      pool_wake_futex(pool, n);
+    } else if (__atomic_load_n(&pool->nb_spinning, __ATOMIC_RELAXED) > 0) {
+      __atomic_add_fetch(&pool->epoch, 1, __ATOMIC_SEQ_CST);
+    }
+    return;
+  }
+  if (idle == 0) {
+    return;
+  }
+  pool_lock(pool);
+  pool_wake_locked(pool, n);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+// Voler une tâche en parcourant les autres travailleurs à partir d'une victime
+// choisie au hasard, ceux du même noeud d'abord
+static struct task* steal_task(struct worker_arg* w) {
+  struct pool* pool = w->pool;
+  int n = pool->nb_threads;
+  int start = xorshift32(&w->seed) % n;
+  int nb_passes = pool->nb_nodes > 1 ? 2 : 1;
+
+  for (int pass = 0; pass < nb_passes; pass++) {
+    for (int i = 0; i < n; i++) {
+      struct worker_arg* victim = &pool->args[(start + i) % n];
+      if (victim == w || (nb_passes > 1 && (victim->node == w->node) == pass)) {
+        continue;
+      }
+      struct task* task = deque_steal(&victim->deque);
+      if (task) {
+        return task;
+      }
+    }
+  }
+  return NULL;
+}
+
+// Ajouter à l'anneau une chaîne de n tâches, par lots réservés d'un seul CAS
+static void ring_push_chain(struct pool* pool, struct ring* ring,
+                            struct task* chain) {
+  void* batch[STEAL_BATCH];
+
+  while (chain) {
+    size_t k = 0;
+    while (chain && k < STEAL_BATCH) {
+      batch[k++] = chain;
+      chain = chain->next;
+    }
+
+    size_t done = 0;
+    while (done < k) {
+      size_t pushed = ring_push_n(ring, batch + done, k - done);
+      if (pushed) {
+        done += pushed;
+        pool_notify(pool, pushed);
+        continue;
+      }
+      // File pleine: un travailleur ne peut pas attendre ses pairs sans risquer
+      // un interblocage, il exécute donc la tâche lui-même
+      if (is_pool_worker(pool)) {
+        run_task(pool, batch[done++]);
+      } else {
+        sched_yield();
+      }
+    }
+  }
+}
+
+// Ajouter une chaîne de n tâches à la file partagée de priorité prio.
+// Retourne -1 si le pool est arrêté.
+static int shared_push(struct pool* pool, enum threadpool_priority prio,
+                       struct task* chain, size_t n) {
+  struct pool_lane* lane = &pool->nodes[caller_node(pool)].lanes[prio];
+
+  if (pool->queue == THREADPOOL_QUEUE_RING) {
+    // Pendant threadpool_join, les travailleurs peuvent encore soumettre des
+    // sous-tâches
+    if (!__atomic_load_n(&pool->running, __ATOMIC_ACQUIRE)
+        && !is_pool_worker(pool)) {
+      return -1;
+    }
+    ring_push_chain(pool, lane->ring, chain);
+    return 0;
+  }
+
+  pool_lock(pool);
+
+  // Vérifier si le pool est en cours d'exécution
+  if (!pool->running && !is_pool_worker(pool)) {
+    pthread_mutex_unlock(&pool->lock);
+    return -1;
+  }
+
+  // Ajouter les tâches à la liste des tâches
+  for (struct task* task = chain; task; task = task->next) {
+    list_push_back(lane->task_list, &task->node);
+  }
+  __atomic_add_fetch(&lane->nb_tasks, n, __ATOMIC_RELAXED);
+
+  // Signaler que de nouvelles tâches sont disponibles
+  if (pool->idle == THREADPOOL_IDLE_BLOCK) {
+    pool_wake_locked(pool, n);
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+  if (pool->idle == THREADPOOL_IDLE_SPIN) {
+    pool_notify(pool, n);
+  }
+  return 0;
+}
+
+// Retirer une tâche d'une file partagée; pool->lock doit être tenu avec
+// task_list
+static struct task* lane_take(struct pool* pool, struct pool_lane* lane) {
+  if (pool->queue == THREADPOOL_QUEUE_RING) {
+    return ring_pop(lane->ring);
+  }
+  if (list_empty(lane->task_list)) {
+    return NULL;
+  }
+  struct list_node* node = list_pop_front(lane->task_list);
+  __atomic_sub_fetch(&lane->nb_tasks, 1, __ATOMIC_RELAXED);
+  return node->data;
+}
+
+// Remettre en tête d'une file partagée une tâche que la deque locale n'a pas
+// pu recevoir; pool->lock doit être tenu avec task_list
+static void lane_put_back(struct pool* pool, struct pool_lane* lane,
+                          struct task* task) {
+  if (pool->queue == THREADPOOL_QUEUE_RING) {
+    // L'anneau a pu être rempli entre-temps: exécuter la tâche sur place
+    if (ring_push_n(lane->ring, (void**)&task, 1) == 0) {
+      run_task(pool, task);
+    }
+    return;
+  }
+  list_push_front(lane->task_list, &task->node);
+  __atomic_add_fetch(&lane->nb_tasks, 1, __ATOMIC_RELAXED);
+}
+
+// Choisir la file non vide la plus prioritaire d'un noeud, sauf si une file
+// moins prioritaire qui attend a déjà été sautée pool->aging fois. Avec
+// l'anneau, les compteurs sont mis à jour sans verrou et l'équité est
+// approximative.
+static struct pool_lane* lane_select(struct pool* pool,
+                                     struct pool_node* node) {
+  struct pool_lane* best = NULL;
+
+  for (int p = 0; p < THREADPOOL_NB_PRIO; p++) {
+    struct pool_lane* lane = &node->lanes[p];
+    if (lane_size(pool, lane) == 0) {
+      continue;
+    }
+    if (!best) {
+      best = lane;
+      continue;
+    }
+    if (pool->aging &&
+        __atomic_add_fetch(&lane->skipped, 1, __ATOMIC_RELAXED) > pool->aging) {
+      best = lane;
       break;
     }
+  }
+  if (best) {
+    __atomic_store_n(&best->skipped, 0, __ATOMIC_RELAXED);
+  }
+  return best;
+}
+
+// Retirer une tâche des files partagées, celles du noeud node d'abord;
+// pool->lock doit être tenu avec task_list. *from reçoit la file d'où vient la
+// tâche.
+static struct task* shared_take(struct pool* pool, int node,
+                                struct pool_lane** from) {
+  struct task* task = NULL;
+  struct pool_lane* lane = NULL;
 
-    // Obtenir une tâche de la liste des tâches
-    struct list_node* node = list_pop_front(pool->task_list);
-    struct task* task = node->data;
-    list_node_unlink(node);
+  for (int i = 0; !task && i < pool->nb_nodes; i++) {
+    struct pool_node* n = &pool->nodes[(node + i) % pool->nb_nodes];
+    lane = lane_select(pool, n);
+    task = lane ? lane_take(pool, lane) : NULL;
 
+    // Avec l'anneau, la file choisie a pu être vidée entre-temps
+    for (int p = 0; !task && p < THREADPOOL_NB_PRIO; p++) {
+      lane = &n->lanes[p];
+      task = lane_take(pool, lane);
+    }
+  }
+  *from = lane;
+  return task;
+}
+
+// Retirer une tâche des files partagées. En mode vol de tâches, un lot de la
+// file normale est transféré dans la deque locale pour que les autres puissent
+// le voler sans repasser par la file partagée. Les tâches urgentes et les
+// tâches de fond restent dans leur file: dans la deque, qui passe avant les
+// files partagées, une tâche de fond doublerait les tâches normales.
+static struct task* shared_pop(struct worker_arg* w) {
+  struct pool* pool = w->pool;
+  int locked = pool->queue == THREADPOOL_QUEUE_LIST;
+
+  if (locked) {
+    pool_lock(pool);
+  }
+
+  struct pool_lane* lane;
+  struct task* task = shared_take(pool, w->node, &lane);
+  if (task && pool->work_stealing && lane->prio == THREADPOOL_PRIO_NORMAL) {
+    size_t batch = lane_size(pool, lane) /
+                   __atomic_load_n(&pool->nb_workers, __ATOMIC_RELAXED);
+    if (batch > STEAL_BATCH) {
+      batch = STEAL_BATCH;
+    }
+    for (size_t i = 0; i < batch; i++) {
+      struct task* extra = lane_take(pool, lane);
+      if (!extra) {
+        break;
+      }
+      if (deque_push(&w->deque, extra) < 0) {
+        lane_put_back(pool, lane, extra);
+        break;
+      }
+    }
+  }
+
+  if (locked) {
     pthread_mutex_unlock(&pool->lock);
+  }
+  return task;
+}
+
+static struct task* worker_next_task(struct worker_arg* w) {
+  struct pool* pool = w->pool;
+  struct task* task;
+
+  if (pool->work_stealing) {
+    // Les tâches urgentes passent avant le travail local
+    struct pool_lane* urgent =
+        &pool->nodes[w->node].lanes[THREADPOOL_PRIO_HIGH];
+    if (lane_size(pool, urgent) > 0) {
+      task = shared_pop(w);
+      if (task) {
+        return task;
+      }
+    }
+    task = deque_pop(&w->deque);
+    if (task) {
+      return task;
+    }
+    task = steal_task(w);
+    if (task) {
+      return task;
+    }
+  }
+
+  return shared_pop(w);
+}
+
+// Échéance de retrait d'un travailleur qui attend, 0 s'il ne se retire jamais
+static int64_t idle_deadline(struct pool* pool) {
+  if (pool->nb_threads == pool->min_threads || pool->idle_timeout_ms == 0) {
+    return 0;
+  }
+  return now_ns() + pool->idle_timeout_ms * 1000000LL;
+}
+
+// Retirer le travailleur courant s'il reste plus de min_threads travailleurs
+// et que rien n'est en attente (pool->lock tenu). Son emplacement est libéré
+// aussitôt et le thread est détaché: il ne doit plus toucher au pool après le
+// déverrouillage. Retourne 1 si le travailleur doit sortir.
+static int worker_retire_locked(struct worker_arg* w) {
+  struct pool* pool = w->pool;
+  if (!pool->running || pool->nb_workers <= pool->min_threads ||
+      pool_has_work(pool)) {
+    return 0;
+  }
+
+  // Compter l'attente tant que l'emplacement appartient encore au travailleur
+  if (pool->stats) {
+    stat_add(&w->stats.idle_ns, now_ns() - w->idle_start, 0);
+  }
+
+  // Rendre le cache de tâches; l'ordre des verrous est lock puis free_lock
+  if (w->free_tasks) {
+    struct task* last = w->free_tasks;
+    while (last->next) {
+      last = last->next;
+    }
+    pthread_mutex_lock(&pool->free_lock);
+    last->next = pool->free_tasks;
+    pool->free_tasks = w->free_tasks;
+    pthread_mutex_unlock(&pool->free_lock);
+    w->free_tasks = NULL;
+    w->nb_free = 0;
+  }
+
+  w->active = 0;
+  __atomic_sub_fetch(&pool->nb_workers, 1, __ATOMIC_RELAXED);
+  pthread_detach(pthread_self());
+  return 1;
+}
+
+// Démarrer un travailleur de plus si les tâches s'accumulent
+static void pool_grow(struct pool* pool) {
+  if (pool->nb_threads == pool->min_threads) {
+    return;
+  }
+  size_t workers = __atomic_load_n(&pool->nb_workers, __ATOMIC_RELAXED);
+  // nb_pending compte aussi les tâches en cours, au plus une par travailleur
+  if (workers >= (size_t)pool->nb_threads ||
+      __atomic_load_n(&pool->nb_pending, __ATOMIC_RELAXED) <=
+          workers * (pool->spawn_threshold + 1)) {
+    return;
+  }
+
+  // Réserver l'emplacement sous le verrou, puis créer le thread sans le
+  // tenir: la création prend des dizaines de µs et bloquerait les
+  // producteurs. threadpool_join() attend les créations en cours.
+  pthread_mutex_lock(&pool->lock);
+  if (!pool->running || pool->nb_workers >= pool->nb_threads) {
+    pthread_mutex_unlock(&pool->lock);
+    return;
+  }
+  struct worker_arg* w = pool->args;
+  while (w->active) {
+    w++;
+  }
+  w->active = 1;
+  w->spawned = 1;
+  w->spin = pool->spin < SPIN_MIN ? pool->spin : SPIN_MIN;
+  __atomic_add_fetch(&pool->nb_workers, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&pool->nb_spawning, 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&pool->lock);
+
+  if (pthread_create(&pool->threads[w->id], NULL, worker, w) != 0) {
+    perror("Échec de la création du thread travailleur");
+    pthread_mutex_lock(&pool->lock);
+    w->active = 0;
+    __atomic_sub_fetch(&pool->nb_workers, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  __atomic_sub_fetch(&pool->nb_spawning, 1, __ATOMIC_RELEASE);
+}
+
+// Attente active sur epoch, puis sched_yield(). Retourne 1 si du travail a
+// été publié.
+static int worker_spin(struct worker_arg* w) {
+  struct pool* pool = w->pool;
+
+  // Lire epoch avant de se déclarer en attente et de parcourir les files une
+  // seule fois: un producteur qui publie ensuite voit nb_spinning et
+  // incrémente epoch. Les itérations ne lisent ensuite que ce mot.
+  uint32_t key = __atomic_load_n(&pool->epoch, __ATOMIC_SEQ_CST);
+  __atomic_add_fetch(&pool->nb_spinning, 1, __ATOMIC_SEQ_CST);
+  int has_work = pool_has_work(pool);
+
+  unsigned int i = 0;
+  for (; !has_work && i < w->spin; i++) {
+    cpu_relax();
+    has_work = __atomic_load_n(&pool->epoch, __ATOMIC_ACQUIRE) != key;
+  }
+  if (has_work) {
+    // Le travail arrive vite: attendre plus longtemps la prochaine fois
+    if (w->spin < pool->spin) {
+      w->spin *= 2;
+    }
+  } else if (w->spin / 2 >= SPIN_MIN) {
+    w->spin /= 2;
+  }
+
+  for (int j = 0; !has_work && j < IDLE_YIELDS; j++) {
+    sched_yield();
+    has_work = __atomic_load_n(&pool->epoch, __ATOMIC_ACQUIRE) != key;
+  }
+  __atomic_sub_fetch(&pool->nb_spinning, 1, __ATOMIC_SEQ_CST);
+  return has_work;
+}
+
+// THREADPOOL_IDLE_SPIN: attente active, puis sched_yield(), puis futex
+static int worker_park_spin(struct worker_arg* w) {
+  struct pool* pool = w->pool;
+
+  if (worker_spin(w)) {
+    return 1;
+  }
+
+  // Compteur d'événements: lire epoch avant de se déclarer endormi et de
+  // vérifier les files. Un producteur qui publie ensuite voit nb_idle et
+  // incrémente epoch, ce qui fait échouer futex_wait.
+  int64_t deadline = idle_deadline(pool);
+  while (1) {
+    uint32_t key = __atomic_load_n(&pool->epoch, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&pool->nb_idle, 1, __ATOMIC_SEQ_CST);
+    int has_work = pool_has_work(pool);
+    int running = __atomic_load_n(&pool->running, __ATOMIC_SEQ_CST);
+    int expired = 0;
+    if (!has_work && running) {
+      if (deadline) {
+        int64_t left = deadline - now_ns();
+        struct timespec timeout = ns_to_timespec(left);
+        if (left > 0) {
+          futex_wait(&pool->epoch, key, &timeout);
+        }
+        expired = left <= 0;
+      } else {
+        futex_wait(&pool->epoch, key, NULL);
+      }
+    }
+    __atomic_sub_fetch(&pool->nb_idle, 1, __ATOMIC_SEQ_CST);
+    if (has_work) {
+      return 1;
+    }
+    if (!running) {
+      return 0;
+    }
+    if (expired) {
+      pool_lock(pool);
+      int retired = worker_retire_locked(w);
+      pthread_mutex_unlock(&pool->lock);
+      if (retired) {
+        return 0;
+      }
+      deadline = idle_deadline(pool);
+    }
+  }
+}
+
+// Attendre du travail. Retourne 0 lorsque le pool est arrêté et qu'il ne reste
+// plus aucune tâche.
+static int worker_park(struct worker_arg* w) {
+  struct pool* pool = w->pool;
+
+  if (pool->idle == THREADPOOL_IDLE_SPIN) {
+    return worker_park_spin(w);
+  }
+
+  int64_t deadline = idle_deadline(pool);
+  int retired = 0;
+
+  pool_lock(pool);
+  __atomic_add_fetch(&pool->nb_idle, 1, __ATOMIC_SEQ_CST);
+
+  // Attendre qu'une tâche soit ajoutée ou que le pool cesse de fonctionner
+  while (pool->running && !pool_has_work(pool)) {
+    if (!deadline) {
+      pthread_cond_wait(&pool->work_todo, &pool->lock);
+      continue;
+    }
+    struct timespec ts = ns_to_timespec(deadline);
+    if (pthread_cond_timedwait(&pool->work_todo, &pool->lock, &ts) ==
+        ETIMEDOUT) {
+      retired = worker_retire_locked(w);
+      if (retired) {
+        break;
+      }
+      deadline = idle_deadline(pool);
+    }
+  }
+  int ret = !retired && (pool->running || pool_has_work(pool));
+
+  __atomic_sub_fetch(&pool->nb_idle, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&pool->lock);
+  return ret;
+}
+
+// Fonction exécutée par chaque thread travailleur
+void* worker(void* arg) {
+  struct worker_arg* w = arg;
+  struct pool* pool = w->pool;
+  current_worker = w;
+
+  if (w->cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+      perror("pthread_setaffinity_np");
+    }
+  }
+
+  // Attendre que tous les threads démarrent
+  if (!w->spawned) {
+    pthread_barrier_wait(&pool->ready);
+  }
+
+  // Boucle principale du thread travailleur
+  while (1) {
+    struct task* task = worker_next_task(w);
+    if (!task) {
+      // Si le pool ne fonctionne pas et que plus rien n'est en attente, sortir.
+      // Un travailleur retiré a déjà compté son attente et ne doit plus
+      // toucher au pool.
+      if (pool->stats) {
+        w->idle_start = now_ns();
+      }
+      if (!worker_park(w)) {
+        break;
+      }
+      if (pool->stats) {
+        stat_add(&w->stats.idle_ns, now_ns() - w->idle_start, 0);
+      }
+      continue;
+    }
 
     // Exécuter la tâche
-    task->func(task->arg);
+    run_task(pool, task);
   }
 
+  current_worker = NULL;
   return NULL;
 }
 
+// Libérer les nb premières files partagées, noeud par noeud
+static void pool_lanes_free(struct pool* pool, int nb) {
+  for (int i = 0; i < nb; i++) {
+    struct pool_lane* lane =
+        &pool->nodes[i / THREADPOOL_NB_PRIO].lanes[i % THREADPOOL_NB_PRIO];
+    list_free(lane->task_list);
+    ring_free(lane->ring);
+  }
+  free(pool->nodes);
+}
+
+void threadpool_attr_init(struct pool_attr* attr, int num) {
+  attr->nb_threads = num;
+  attr->work_stealing = 0;
+  attr->queue = THREADPOOL_QUEUE_LIST;
+  attr->ring_capacity = RING_DEFAULT_CAPACITY;
+  attr->aging = THREADPOOL_AGING;
+  attr->affinity = THREADPOOL_AFFINITY_NONE;
+  attr->idle = THREADPOOL_IDLE_BLOCK;
+  attr->spin = THREADPOOL_SPIN;
+  attr->max_threads = 0;
+  attr->spawn_threshold = THREADPOOL_SPAWN_THRESHOLD;
+  attr->idle_timeout_ms = THREADPOOL_IDLE_TIMEOUT_MS;
+  attr->max_pending = 0;
+  attr->stats = 0;
+}
+
 // Créer un nouveau pool de threads avec un certain nombre de threads
 struct pool* threadpool_create(int num) {
+  struct pool_attr attr;
+  threadpool_attr_init(&attr, num);
+  return threadpool_create_attr(&attr);
+}
+
+struct pool* threadpool_create_attr(const struct pool_attr* attr) {
+  int num = attr->nb_threads;
+  int max = attr->max_threads > num ? attr->max_threads : num;
   struct pool* pool = malloc(sizeof(struct pool));
   if (!pool) {
     perror("Échec de l'allocation de mémoire pour le pool de threads");
@@ -55,28 +944,116 @@ struct pool* threadpool_create(int num) {
   }
 
   // Initialiser les variables du pool
-  pool->nb_threads = num;
+  pool->nb_threads = max;
+  pool->min_threads = num;
+  pool->nb_workers = num;
+  pool->spawn_threshold = attr->spawn_threshold;
+  pool->idle_timeout_ms = attr->idle_timeout_ms;
+  pool->work_stealing = attr->work_stealing;
+  pool->queue = attr->queue;
+  pool->nb_pending = 0;
+  pool->nb_waiters = 0;
+  pool->nb_blocked = 0;
+  pool->max_pending = attr->max_pending;
+  pool->stats = attr->stats;
+  memset(&pool->extern_stats, 0, sizeof(pool->extern_stats));
+  pool->nb_idle = 0;
+  pool->nb_spinning = 0;
+  pool->nb_spawning = 0;
+  pool->idle = attr->idle;
+  pool->spin = attr->spin;
+  pool->epoch = 0;
   pool->running = 1;
-  pool->task_list = list_new(NULL, NULL);
+  pool->aging = attr->aging;
+  pool->free_tasks = NULL;
+  pool->slabs = NULL;
+  pool->task_allocs = 0;
+  pool->nb_nodes = 1;
+  memset(&pool->topology, 0, sizeof(pool->topology));
+  if (attr->affinity == THREADPOOL_AFFINITY_NUMA &&
+      topology_init(&pool->topology) == 0) {
+    pool->nb_nodes = pool->topology.nb_nodes;
+  }
+  pool->nodes = aligned_alloc(CACHELINE_SIZE,
+                              pool->nb_nodes * sizeof(struct pool_node));
+  if (!pool->nodes) {
+    perror("Échec de l'allocation des files du pool");
+    topology_destroy(&pool->topology);
+    free(pool);
+    return NULL;
+  }
+  for (int i = 0; i < pool->nb_nodes * THREADPOOL_NB_PRIO; i++) {
+    struct pool_lane* lane =
+        &pool->nodes[i / THREADPOOL_NB_PRIO].lanes[i % THREADPOOL_NB_PRIO];
+    lane->task_list = list_new(NULL, NULL);
+    lane->ring = NULL;
+    lane->nb_tasks = 0;
+    lane->skipped = 0;
+    lane->prio = i % THREADPOOL_NB_PRIO;
+    if (pool->queue == THREADPOOL_QUEUE_RING) {
+      lane->ring = ring_new(attr->ring_capacity);
+      if (!lane->ring) {
+        pool_lanes_free(pool, i + 1);
+        topology_destroy(&pool->topology);
+        free(pool);
+        return NULL;
+      }
+    }
+  }
   pthread_mutex_init(&pool->lock, NULL);
-  pthread_cond_init(&pool->work_todo, NULL);
-  pthread_cond_init(&pool->work_done, NULL);
+  pthread_mutex_init(&pool->free_lock, NULL);
+  // Les échéances de retrait et d'aide sont sur CLOCK_MONOTONIC
+  pthread_condattr_t cond_attr;
+  pthread_condattr_init(&cond_attr);
+  pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&pool->work_todo, &cond_attr);
+  pthread_cond_init(&pool->work_done, &cond_attr);
+  pthread_cond_init(&pool->room, NULL);
+  pthread_condattr_destroy(&cond_attr);
   pthread_barrier_init(&pool->ready, NULL, num + 1);
 
-  // Allouer de la mémoire pour les threads et les arguments des travailleurs
-  pool->threads = malloc(num * sizeof(pthread_t));
-  pool->args = malloc(num * sizeof(struct worker_arg));
+  // Allouer de la mémoire pour les threads et les arguments des travailleurs,
+  // un emplacement par travailleur possible
+  pool->threads = malloc(max * sizeof(pthread_t));
+  pool->args = aligned_alloc(CACHELINE_SIZE, max * sizeof(struct worker_arg));
   if (!pool->threads || !pool->args) {
     perror("Échec de l'allocation de mémoire pour les threads ou les arguments des travailleurs");
+    if (pool->args) {
+      memset(pool->args, 0, max * sizeof(struct worker_arg));
+    }
     threadpool_join(pool);
     return NULL;
   }
+  memset(pool->args, 0, max * sizeof(struct worker_arg));
 
-  // Créer les threads travailleurs
-  for (int i = 0; i < num; i++) {
+  for (int i = 0; i < max; i++) {
     pool->args[i].id = i;
     pool->args[i].pool = pool;
+    pool->args[i].seed = 2654435761u * (i + 1);
+    pool->args[i].spin = attr->spin < SPIN_MIN ? attr->spin : SPIN_MIN;
+    pool->args[i].node = 0;
+    pool->args[i].cpu = -1;
+    if (pool->topology.cpus) {
+      // Noeuds à tour de rôle, puis les processeurs de chaque noeud
+      struct topology* topo = &pool->topology;
+      int node = i % topo->nb_nodes;
+      int first = topo->node_first[node];
+      int size = topo->node_first[node + 1] - first;
+      pool->args[i].node = node;
+      pool->args[i].cpu = topo->cpus[first + (i / topo->nb_nodes) % size];
+    }
+    if (deque_init(&pool->args[i].deque, 256) < 0) {
+      // Aucun thread n'est lancé: les deques non initialisées sont à NULL
+      threadpool_join(pool);
+      return NULL;
+    }
+  }
+
+  // Créer les threads travailleurs
+  for (int i = 0; i < num; i++) {
+    pool->args[i].active = 1;
     if (pthread_create(&pool->threads[i], NULL, worker, &pool->args[i]) != 0) {
+      pool->args[i].active = 0;
       perror("Échec de la création du thread travailleur");
       threadpool_join(pool);
       return NULL;
@@ -89,53 +1066,368 @@ struct pool* threadpool_create(int num) {
   return pool;
 }
 
-// Ajouter une tâche au pool de threads
-void threadpool_add_task(struct pool* pool, func_t fn, void* arg) {
-  pthread_mutex_lock(&pool->lock);
+// Publier une chaîne de n tâches déjà comptées par pool_reserve()
+static void submit_chain(struct pool* pool, enum threadpool_priority prio,
+                         struct task* chain, size_t n) {
+  if (pool->stats) {
+    int64_t now = now_ns();
+    for (struct task* task = chain; task; task = task->next) {
+      task->submitted_ns = now;
+    }
+  }
 
-  // Vérifier si le pool est en cours d'exécution
-  if (!pool->running) {
-    pthread_mutex_unlock(&pool->lock);
+  // Une tâche normale créée par un travailleur va dans sa deque, sans verrou
+  if (pool->work_stealing && prio == THREADPOOL_PRIO_NORMAL &&
+      is_pool_worker(pool)) {
+    size_t pushed = 0;
+    while (chain) {
+      // Lire next avant de publier: un voleur peut exécuter et recycler la
+      // tâche aussitôt
+      struct task* next = chain->next;
+      if (deque_push(&current_worker->deque, chain) < 0) {
+        break;
+      }
+      chain = next;
+      pushed++;
+    }
+    if (pushed) {
+      pool_notify(pool, pushed);
+    }
+    if (!chain) {
+      pool_grow(pool);
+      return;
+    }
+    // La deque n'a pas pu grandir: le reste passe par la file partagée
+    n -= pushed;
+  }
+
+  // Pendant threadpool_join, les travailleurs peuvent encore soumettre des
+  // sous-tâches; les autres soumissions sont ignorées
+  if (shared_push(pool, prio, chain, n) < 0) {
+    for (struct task* task = chain; task; task = task->next) {
+      if (task->future) {
+        __atomic_store_n(&task->future->done, 1, __ATOMIC_SEQ_CST);
+      }
+      if (task->group) {
+        __atomic_sub_fetch(&task->group->pending, 1, __ATOMIC_SEQ_CST);
+      }
+    }
+    task_free_chain(pool, chain);
+    pool_tasks_done(pool, n);
     return;
   }
+  pool_grow(pool);
+}
 
-  // Créer une nouvelle tâche et l'ajouter à la liste des tâches
-  struct task* new_task = malloc(sizeof(struct task));
+// Soumettre une tâche. Retourne 0, EAGAIN si le pool borné est plein et que
+// block est faux, ou ENOMEM.
+static int submit_one(struct pool* pool, enum threadpool_priority prio,
+                      func_t fn, void* arg, struct future* future,
+                      struct taskgroup* group, int block) {
+  int ret = pool_reserve(pool, 1, block);
+  if (ret) {
+    return ret;
+  }
+  struct task* new_task = task_alloc_n(pool, 1);
+  if (!new_task) {
+    pool_tasks_done(pool, 1);
+    return ENOMEM;
+  }
   new_task->func = fn;
   new_task->arg = arg;
+  new_task->future = future;
+  new_task->group = group;
+  new_task->next = NULL;
+  if (group) {
+    __atomic_add_fetch(&group->pending, 1, __ATOMIC_SEQ_CST);
+  }
+  submit_chain(pool, prio, new_task, 1);
+  return 0;
+}
+
+// Ajouter une tâche au pool de threads
+void threadpool_add_task_prio(struct pool* pool, enum threadpool_priority prio,
+                              func_t fn, void* arg) {
+  submit_one(pool, prio, fn, arg, NULL, NULL, 1);
+}
 
-  struct list_node* node = list_node_new(new_task);
-  list_push_back(pool->task_list, node);
+int threadpool_try_add_task(struct pool* pool, func_t fn, void* arg) {
+  return submit_one(pool, THREADPOOL_PRIO_NORMAL, fn, arg, NULL, NULL, 0);
+}
 
-  // Signaler qu'une nouvelle tâche est disponible
-  pthread_cond_signal(&pool->work_todo);
+void threadpool_add_task(struct pool* pool, func_t fn, void* arg) {
+  threadpool_add_task_prio(pool, THREADPOOL_PRIO_NORMAL, fn, arg);
+}
 
+// Ajouter n tâches fn(args[i]) avec une seule prise de verrou (ou une seule
+// réservation dans l'anneau par lot) et réveiller min(n, nb_idle) travailleurs
+void threadpool_add_tasks_prio(struct pool* pool, enum threadpool_priority prio,
+                               func_t fn, void** args, size_t n) {
+  if (n == 0) {
+    return;
+  }
+  pool_reserve(pool, n, 1);
+  struct task* chain = task_alloc_n(pool, n);
+  if (!chain) {
+    pool_tasks_done(pool, n);
+    return;
+  }
+  size_t i = 0;
+  for (struct task* task = chain; task; task = task->next) {
+    task->func = fn;
+    task->arg = args[i++];
+    task->future = NULL;
+    task->group = NULL;
+  }
+  submit_chain(pool, prio, chain, n);
+}
+
+void threadpool_add_tasks(struct pool* pool, func_t fn, void** args, size_t n) {
+  threadpool_add_tasks_prio(pool, THREADPOOL_PRIO_NORMAL, fn, args, n);
+}
+
+// Ajouter une tâche dont le résultat sera disponible par future_get(f)
+void threadpool_submit_prio(struct pool* pool, enum threadpool_priority prio,
+                            struct future* f, func_t fn, void* arg) {
+  f->pool = pool;
+  f->result = NULL;
+  f->done = 0;
+
+  if (submit_one(pool, prio, fn, arg, f, NULL, 1)) {
+    f->done = 1;
+  }
+}
+
+void threadpool_submit(struct pool* pool, struct future* f, func_t fn,
+                       void* arg) {
+  threadpool_submit_prio(pool, THREADPOOL_PRIO_NORMAL, f, fn, arg);
+}
+
+int future_done(struct future* f) {
+  return __atomic_load_n(&f->done, __ATOMIC_ACQUIRE);
+}
+
+// Attendre la fin de la tâche et retourner sa valeur de retour
+void* future_get(struct future* f) {
+  struct pool* pool = f->pool;
+
+  if (!future_done(f)) {
+    pthread_mutex_lock(&pool->lock);
+    __atomic_add_fetch(&pool->nb_waiters, 1, __ATOMIC_SEQ_CST);
+    while (!__atomic_load_n(&f->done, __ATOMIC_SEQ_CST)) {
+      pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    __atomic_sub_fetch(&pool->nb_waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  return f->result;
+}
+
+// Attendre que toutes les tâches soumises soient terminées, sans arrêter les
+// travailleurs: le pool peut ensuite recevoir un autre lot. Ne doit pas être
+// appelée depuis une tâche du pool.
+void threadpool_wait(struct pool* pool) {
+  pthread_mutex_lock(&pool->lock);
+  __atomic_add_fetch(&pool->nb_waiters, 1, __ATOMIC_SEQ_CST);
+  while (__atomic_load_n(&pool->nb_pending, __ATOMIC_SEQ_CST) > 0) {
+    pthread_cond_wait(&pool->work_done, &pool->lock);
+  }
+  __atomic_sub_fetch(&pool->nb_waiters, 1, __ATOMIC_SEQ_CST);
   pthread_mutex_unlock(&pool->lock);
 }
 
 // Attendre que toutes les tâches soient terminées et libérer les ressources du pool
 void threadpool_join(struct pool* pool) {
   pthread_mutex_lock(&pool->lock);
-  pool->running = 0;
+  __atomic_store_n(&pool->running, 0, __ATOMIC_SEQ_CST);
   pthread_cond_broadcast(&pool->work_todo);
   pthread_mutex_unlock(&pool->lock);
+  pool_wake_futex(pool, INT_MAX);
 
-  // Attendre que tous les threads se terminent
-  for (int i = 0; i < pool->nb_threads; i++) {
-    pthread_join(pool->threads[i], NULL);
+  // running à 0 empêche pool_grow() de réserver un emplacement; attendre que
+  // les créations déjà commencées aient écrit pool->threads
+  while (__atomic_load_n(&pool->nb_spawning, __ATOMIC_ACQUIRE) > 0) {
+    sched_yield();
+  }
+
+  // Attendre que tous les threads se terminent; les travailleurs retirés sont
+  // détachés et running à 0 empêche d'en démarrer d'autres
+  for (int i = 0; pool->args && i < pool->nb_threads; i++) {
+    if (pool->args[i].active) {
+      pthread_join(pool->threads[i], NULL);
+    }
   }
 
   // Détruire les mutex, les conditions et la barrière
   pthread_mutex_destroy(&pool->lock);
+  pthread_mutex_destroy(&pool->free_lock);
   pthread_cond_destroy(&pool->work_todo);
   pthread_cond_destroy(&pool->work_done);
+  pthread_cond_destroy(&pool->room);
   pthread_barrier_destroy(&pool->ready);
 
   // Libérer la mémoire allouée pour la liste des tâches, les threads et les arguments des travailleurs
-  list_free(pool->task_list);
+  if (pool->args) {
+    for (int i = 0; i < pool->nb_threads; i++) {
+      deque_destroy(&pool->args[i].deque);
+    }
+  }
+  while (pool->slabs) {
+    struct task_slab* next = pool->slabs->next;
+    free(pool->slabs);
+    pool->slabs = next;
+  }
+  pool_lanes_free(pool, pool->nb_nodes * THREADPOOL_NB_PRIO);
+  topology_destroy(&pool->topology);
   free(pool->threads);
   free(pool->args);
 
   // Libérer la mémoire allouée pour le pool
   free(pool);
-}
\ No newline at end of file
+}
+
+int threadpool_help(struct pool* pool) {
+  struct task* task;
+
+  if (is_pool_worker(pool)) {
+    task = worker_next_task(current_worker);
+  } else {
+    int locked = pool->queue == THREADPOOL_QUEUE_LIST;
+    struct pool_lane* lane;
+    if (locked) {
+      pthread_mutex_lock(&pool->lock);
+    }
+    task = shared_take(pool, caller_node(pool), &lane);
+    if (locked) {
+      pthread_mutex_unlock(&pool->lock);
+    }
+  }
+  if (!task) {
+    return 0;
+  }
+  run_task(pool, task);
+  return 1;
+}
+
+void taskgroup_init(struct taskgroup* group, struct pool* pool) {
+  group->pool = pool;
+  group->pending = 0;
+}
+
+void taskgroup_run(struct taskgroup* group, func_t fn, void* arg) {
+  if (submit_one(group->pool, THREADPOOL_PRIO_NORMAL, fn, arg, NULL, group,
+                 1)) {
+    // Sans tâche, exécuter sur place plutôt que perdre le travail du groupe
+    fn(arg);
+  }
+}
+
+// Attendre les tâches du groupe en exécutant celles du pool. Le thread ne
+// dort que s'il n'y a rien à exécuter, et au plus HELP_SLEEP_NS: une tâche
+// publiée pendant qu'il dort ne le réveille pas.
+void taskgroup_wait(struct taskgroup* group) {
+  struct pool* pool = group->pool;
+
+  while (__atomic_load_n(&group->pending, __ATOMIC_SEQ_CST) > 0) {
+    if (threadpool_help(pool)) {
+      continue;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    __atomic_add_fetch(&pool->nb_waiters, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&group->pending, __ATOMIC_SEQ_CST) > 0 &&
+        !pool_has_work(pool)) {
+      struct timespec ts = ns_to_timespec(now_ns() + HELP_SLEEP_NS);
+      pthread_cond_timedwait(&pool->work_done, &pool->lock, &ts);
+    }
+    __atomic_sub_fetch(&pool->nb_waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+// Identifiant du travailleur appelant dans ce pool, -1 hors du pool
+int threadpool_worker_id(struct pool* pool) {
+  return is_pool_worker(pool) ? current_worker->id : -1;
+}
+
+// Nombre de travailleurs vivants
+int threadpool_nb_workers(struct pool* pool) {
+  return __atomic_load_n(&pool->nb_workers, __ATOMIC_RELAXED);
+}
+
+// Nombre d'allocations sur le tas faites pour les tâches depuis la création
+size_t threadpool_task_allocs(struct pool* pool) {
+  return __atomic_load_n(&pool->task_allocs, __ATOMIC_RELAXED);
+}
+
+static void stats_merge(struct threadpool_stats* to,
+                        const struct threadpool_stats* from) {
+  const uint64_t* src = (const uint64_t*)from;
+  uint64_t* dst = (uint64_t*)to;
+  for (size_t i = 0; i < sizeof(*from) / sizeof(uint64_t); i++) {
+    dst[i] += __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+  }
+}
+
+void threadpool_get_stats(struct pool* pool, int worker,
+                          struct threadpool_stats* stats) {
+  memset(stats, 0, sizeof(*stats));
+  if (worker >= 0) {
+    if (worker < pool->nb_threads) {
+      stats_merge(stats, &pool->args[worker].stats);
+    }
+    return;
+  }
+  // Les travailleurs retirés gardent leurs compteurs dans leur emplacement
+  for (int i = 0; i < pool->nb_threads; i++) {
+    stats_merge(stats, &pool->args[i].stats);
+  }
+  stats_merge(stats, &pool->extern_stats);
+}
+
+uint64_t threadpool_hist_percentile(const uint64_t* hist, double p) {
+  uint64_t total = 0;
+  for (int i = 0; i < THREADPOOL_HIST_BUCKETS; i++) {
+    total += hist[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t rank = (uint64_t)(p * total);
+  uint64_t seen = 0;
+  for (int i = 0; i < THREADPOOL_HIST_BUCKETS - 1; i++) {
+    seen += hist[i];
+    if (seen > rank) {
+      return (uint64_t)2 << i;
+    }
+  }
+  return UINT64_MAX;
+}
+
+void threadpool_stats_print(FILE* out, struct pool* pool) {
+  struct threadpool_stats total;
+  threadpool_get_stats(pool, -1, &total);
+
+  fprintf(out, "tasks: %lu (outside workers: %lu)\n",
+          (unsigned long)total.nb_tasks,
+          (unsigned long)__atomic_load_n(&pool->extern_stats.nb_tasks,
+                                         __ATOMIC_RELAXED));
+  fprintf(out, "queue wait: p50 < %lu ns, p99 < %lu ns\n",
+          (unsigned long)threadpool_hist_percentile(total.wait_hist, 0.5),
+          (unsigned long)threadpool_hist_percentile(total.wait_hist, 0.99));
+  fprintf(out, "execution:  p50 < %lu ns, p99 < %lu ns\n",
+          (unsigned long)threadpool_hist_percentile(total.exec_hist, 0.5),
+          (unsigned long)threadpool_hist_percentile(total.exec_hist, 0.99));
+  fprintf(out, "%8s %10s %12s %12s %12s %10s\n", "worker", "tasks",
+          "busy (ms)", "idle (ms)", "lock (ms)", "acquires");
+  for (int i = 0; i < pool->nb_threads; i++) {
+    struct threadpool_stats s;
+    threadpool_get_stats(pool, i, &s);
+    if (s.nb_tasks == 0 && s.idle_ns == 0) {
+      continue;  // emplacement jamais utilisé
+    }
+    fprintf(out, "%8d %10lu %12.3f %12.3f %12.3f %10lu\n", i,
+            (unsigned long)s.nb_tasks, s.busy_ns * 1e-6, s.idle_ns * 1e-6,
+            s.lock_ns * 1e-6, (unsigned long)s.lock_acquires);
+  }
+}
@@ -3,9 +3,14 @@
 
 #include <pthread.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <sys/types.h>
 
+#include "cpu.h"
+#include "deque.h"
 #include "list.h"
+#include "ring.h"
+#include "topology.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -13,18 +18,219 @@ extern "C" {
 
 typedef void *(*func_t)(void *);
 
-struct worker_arg {
-  int id;
+/*
+ * Les tâches sont allouées par blocs de THREADPOOL_TASK_SLAB et recyclées: une
+ * tâche exécutée retourne dans le cache de son travailleur, qui en garde au
+ * plus THREADPOOL_TASK_CACHE avant d'en rendre la moitié au pool. En régime
+ * permanent, soumettre et exécuter une tâche ne fait aucune allocation.
+ */
+#define THREADPOOL_TASK_SLAB 256
+#define THREADPOOL_TASK_CACHE 64
+
+/*
+ * Poignée de complétion d'une tâche soumise avec threadpool_submit(). Elle est
+ * fournie par l'appelant, qui ne doit pas la réutiliser avant future_get().
+ */
+struct future {
   struct pool *pool;
+  void *result;
+  int done;
 };
 
+struct taskgroup;
+
 struct task {
   func_t func;
   void *arg;
+  struct future *future;
+  struct taskgroup *group;
+  uint64_t submitted_ns;  // avec pool_attr.stats seulement
+  struct task *next;      // liste des tâches libres
+  struct list_node node;  // maillon d'une task_list, node.data pointe la tâche
 };
 
-struct pool {
+struct task_slab;
+
+/*
+ * Compteurs d'activité, activés par pool_attr.stats. Chaque travailleur a les
+ * siens dans sa ligne de cache et les met à jour sans instruction atomique;
+ * threadpool_get_stats() les additionne à la demande. Les tâches exécutées par
+ * d'autres threads (taskgroup_wait, threadpool_help) sont comptées à part.
+ *
+ * Histogrammes en puissances de deux: la case i compte les durées de
+ * [2^i, 2^(i+1)) ns, la dernière aussi les durées plus longues.
+ *
+ * lock_ns est le temps passé par les travailleurs à acquérir pool->lock; il
+ * mesure la contention, alors que des busy_ns très inégaux entre travailleurs
+ * indiquent un déséquilibre de charge. Une tâche exécutée pendant qu'une autre
+ * attend (taskgroup_wait) est comptée dans le busy_ns des deux.
+ */
+#define THREADPOOL_HIST_BUCKETS 32
+
+struct threadpool_stats {
+  uint64_t nb_tasks;
+  uint64_t busy_ns;        // exécution des tâches
+  uint64_t idle_ns;        // attente de travail
+  uint64_t lock_ns;        // acquisition de pool->lock
+  uint64_t lock_acquires;
+  uint64_t wait_hist[THREADPOOL_HIST_BUCKETS];  // de la soumission au début
+  uint64_t exec_hist[THREADPOOL_HIST_BUCKETS];  // durée d'exécution
+};
+
+struct worker_arg {
+  int id;
+  int active;   // l'emplacement a un thread vivant (pool->lock)
+  int spawned;  // démarré après threadpool_create_attr(), sans la barrière
+  int node;  // noeud NUMA du travailleur, 0 sans affinité
+  int cpu;   // processeur sur lequel il est épinglé, -1 sans affinité
+  struct pool *pool;
+  struct deque deque;       // tâches locales en mode vol de tâches
+  unsigned int seed;        // choix aléatoire des victimes
+  unsigned int spin;        // durée de l'attente active adaptative
+  struct task *free_tasks;  // cache de tâches libres, sans verrou
+  int nb_free;
+  struct threadpool_stats stats;
+  int64_t idle_start;  // début de l'attente en cours, avec les statistiques
+} CACHELINE_ALIGNED;
+
+// File partagée entre les producteurs et les travailleurs
+enum threadpool_queue {
+  THREADPOOL_QUEUE_LIST,  // task_list protégée par pool->lock
+  THREADPOOL_QUEUE_RING,  // anneau MPMC borné, sans verrou
+};
+
+/*
+ * Priorité choisie à la soumission. Chaque priorité a sa propre file partagée;
+ * un travailleur prend dans la file non vide la plus prioritaire, et les
+ * tâches urgentes passent avant le travail de sa deque locale. Pour qu'une
+ * file ne soit pas affamée, une file non vide est servie au plus tard après
+ * pool->aging prises dans des files plus prioritaires; avec aging à 0, les
+ * priorités sont strictes.
+ *
+ * threadpool_add_task() et les autres fonctions sans priorité utilisent
+ * THREADPOOL_PRIO_NORMAL. En mode vol de tâches, seules les sous-tâches
+ * normales vont dans la deque locale.
+ */
+enum threadpool_priority {
+  THREADPOOL_PRIO_HIGH,
+  THREADPOOL_PRIO_NORMAL,
+  THREADPOOL_PRIO_LOW,
+  THREADPOOL_NB_PRIO,
+};
+
+#define THREADPOOL_AGING 8
+
+struct pool_lane {
+  struct list *task_list;  // THREADPOOL_QUEUE_LIST
+  struct ring *ring;       // THREADPOOL_QUEUE_RING
+  enum threadpool_priority prio;
+  size_t nb_tasks;       // taille de task_list, lisible sans verrou
+  unsigned int skipped;  // prises dans une file plus prioritaire depuis la
+                         // dernière prise dans celle-ci
+};
+
+/*
+ * Placement des travailleurs.
+ *
+ * THREADPOOL_AFFINITY_NUMA: les travailleurs sont répartis à tour de rôle sur
+ * les noeuds NUMA (voir struct topology), puis épinglés chacun sur un
+ * processeur de leur noeud. Chaque noeud a ses propres files partagées: une
+ * tâche soumise va dans les files du noeud du thread qui la soumet, et un
+ * travailleur sert les files de son noeud avant celles des autres. Le vol de
+ * tâches choisit aussi une victime du même noeud avant les autres. Les
+ * priorités sont respectées à l'intérieur d'un noeud.
+ */
+enum threadpool_affinity {
+  THREADPOOL_AFFINITY_NONE,
+  THREADPOOL_AFFINITY_NUMA,
+};
+
+struct pool_node {
+  struct pool_lane lanes[THREADPOOL_NB_PRIO];
+} CACHELINE_ALIGNED;
+
+/*
+ * Attente d'un travailleur sans travail.
+ *
+ * THREADPOOL_IDLE_BLOCK: il se bloque aussitôt sur pool->work_todo.
+ *
+ * THREADPOOL_IDLE_SPIN: il vérifie une fois les files, puis surveille le
+ * compteur d'événements pool->epoch avec cpu_relax(), au plus spin
+ * itérations, puis cède quelques fois le processeur, puis s'endort sur ce
+ * compteur (futex). La durée de l'attente active s'adapte: elle double
+ * lorsque du travail arrive pendant l'attente et diminue de moitié sinon. Un
+ * producteur n'incrémente epoch que si un travailleur attend, et ne fait
+ * l'appel système que si un travailleur est endormi.
+ */
+enum threadpool_idle {
+  THREADPOOL_IDLE_BLOCK,
+  THREADPOOL_IDLE_SPIN,
+};
+
+#define THREADPOOL_SPIN 2048
+
+/*
+ * Pool élastique. Le pool démarre nb_threads travailleurs et en ajoute, jusqu'à
+ * max_threads, lorsqu'une soumission trouve plus de spawn_threshold tâches en
+ * attente par travailleur. Un travailleur qui reste sans travail pendant
+ * idle_timeout_ms se retire, ce qui libère sa pile; il en reste toujours au
+ * moins nb_threads. Avec max_threads <= nb_threads, le nombre de travailleurs
+ * est fixe.
+ */
+#define THREADPOOL_SPAWN_THRESHOLD 1
+#define THREADPOOL_IDLE_TIMEOUT_MS 1000
+
+/*
+ * Attributs de création du pool.
+ *
+ * work_stealing: chaque travailleur possède une deque. Une tâche soumise depuis
+ * une tâche du pool va dans la deque locale sans verrou; les tâches soumises de
+ * l'extérieur passent par la file partagée. Un travailleur sans travail vole
+ * une tâche à une victime choisie au hasard.
+ *
+ * queue: implémentation des files partagées. Avec THREADPOOL_QUEUE_RING, chaque
+ * file contient au plus ring_capacity tâches; un producteur externe attend
+ * qu'une place se libère, un travailleur exécute plutôt la tâche lui-même.
+ *
+ * aging: voir enum threadpool_priority.
+ *
+ * idle, spin: voir enum threadpool_idle.
+ *
+ * max_threads, spawn_threshold, idle_timeout_ms: voir
+ * THREADPOOL_SPAWN_THRESHOLD.
+ *
+ * stats: compter l'activité des travailleurs (struct threadpool_stats).
+ *
+ * max_pending: si non nul, au plus max_pending tâches soumises et pas encore
+ * terminées. Un producteur externe attend qu'une place se libère dans
+ * threadpool_add_task() et les autres fonctions de soumission, ou reçoit
+ * EAGAIN de threadpool_try_add_task(). Les sous-tâches soumises par les
+ * travailleurs ne sont jamais bloquées et peuvent dépasser la borne.
+ */
+struct pool_attr {
   int nb_threads;
+  int work_stealing;
+  enum threadpool_queue queue;
+  size_t ring_capacity;
+  unsigned int aging;
+  enum threadpool_affinity affinity;
+  enum threadpool_idle idle;
+  unsigned int spin;
+  int max_threads;
+  unsigned int spawn_threshold;
+  unsigned int idle_timeout_ms;
+  size_t max_pending;
+  int stats;
+};
+
+struct pool {
+  int nb_threads;   // emplacements de travailleurs, max_threads
+  int min_threads;  // travailleurs qui ne se retirent jamais
+  int nb_workers;   // travailleurs vivants (pool->lock, lisible sans verrou)
+  unsigned int spawn_threshold;
+  unsigned int idle_timeout_ms;
+  int work_stealing;
+  enum threadpool_queue queue;
   pthread_t *threads;
   struct worker_arg *args;
   pthread_barrier_t ready;
@@ -33,14 +239,93 @@ struct pool {
   pthread_cond_t work_todo;
   pthread_cond_t work_done;
 
-  struct list *task_list;
+  struct pool_node *nodes;
+  int nb_nodes;
+  struct topology topology;  // avec THREADPOOL_AFFINITY_NUMA seulement
+  unsigned int aging;
+
+  pthread_mutex_t free_lock;
+  struct task *free_tasks;
+  struct task_slab *slabs;
+  size_t task_allocs;
+
+  enum threadpool_idle idle;
+  unsigned int spin;
+  uint32_t epoch;  // futex des travailleurs endormis, THREADPOOL_IDLE_SPIN
 
+  int stats;
+  struct threadpool_stats extern_stats;  // tâches exécutées hors travailleurs
+
+  size_t max_pending;
+  pthread_cond_t room;  // place libérée dans un pool borné
+  int nb_blocked;       // producteurs bloqués sur room
+
+  size_t nb_pending;  // tâches soumises et pas encore terminées
+  int nb_waiters;     // threads bloqués sur work_done
+  int nb_idle;        // travailleurs endormis
+  int nb_spinning;    // travailleurs en attente active sur epoch
+  int nb_spawning;    // travailleurs en cours de création par pool_grow()
   int running;
 };
 
+void threadpool_attr_init(struct pool_attr *attr, int num);
 struct pool *threadpool_create(int num);
+struct pool *threadpool_create_attr(const struct pool_attr *attr);
 void threadpool_add_task(struct pool *pool, func_t fn, void *arg);
+// Retourne 0, EAGAIN si le pool borné est plein, ou ENOMEM
+int threadpool_try_add_task(struct pool *pool, func_t fn, void *arg);
+void threadpool_add_tasks(struct pool *pool, func_t fn, void **args, size_t n);
+void threadpool_add_task_prio(struct pool *pool, enum threadpool_priority prio,
+                              func_t fn, void *arg);
+void threadpool_add_tasks_prio(struct pool *pool, enum threadpool_priority prio,
+                               func_t fn, void **args, size_t n);
+void threadpool_wait(struct pool *pool);
 void threadpool_join(struct pool *pool);
+int threadpool_worker_id(struct pool *pool);
+int threadpool_nb_workers(struct pool *pool);
+
+void threadpool_submit(struct pool *pool, struct future *f, func_t fn,
+                       void *arg);
+void threadpool_submit_prio(struct pool *pool, enum threadpool_priority prio,
+                            struct future *f, func_t fn, void *arg);
+int future_done(struct future *f);
+void *future_get(struct future *f);
+
+size_t threadpool_task_allocs(struct pool *pool);
+
+// Compteurs du travailleur worker, ou de tout le pool avec worker = -1
+void threadpool_get_stats(struct pool *pool, int worker,
+                          struct threadpool_stats *stats);
+// Borne supérieure en ns de la case qui contient le centile p (0 à 1)
+uint64_t threadpool_hist_percentile(const uint64_t *hist, double p);
+// Résumé du pool, puis une ligne par travailleur
+void threadpool_stats_print(FILE *out, struct pool *pool);
+
+/*
+ * Exécuter une tâche en attente dans le pool, s'il y en a une. Un travailleur
+ * prend d'abord dans sa deque, puis vole, puis prend dans les files partagées;
+ * un autre thread prend dans les files partagées. Retourne 1 si une tâche a
+ * été exécutée.
+ */
+int threadpool_help(struct pool *pool);
+
+/*
+ * Groupe de tâches pour le fork-join imbriqué. taskgroup_wait() attend les
+ * tâches lancées par taskgroup_run() en exécutant des tâches du pool plutôt
+ * que de dormir: une tâche peut attendre ses sous-tâches sans bloquer un
+ * travailleur, et les niveaux de récursion s'imbriquent sans interblocage ni
+ * threads supplémentaires. Le thread qui attend ne dort que lorsqu'il ne reste
+ * rien à exécuter. Le groupe vit en général sur la pile de la tâche qui
+ * attend; il peut être réutilisé après taskgroup_wait().
+ */
+struct taskgroup {
+  struct pool *pool;
+  size_t pending;  // tâches du groupe pas encore terminées
+};
+
+void taskgroup_init(struct taskgroup *group, struct pool *pool);
+void taskgroup_run(struct taskgroup *group, func_t fn, void *arg);
+void taskgroup_wait(struct taskgroup *group);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,138 @@
+#define _GNU_SOURCE
+#include "topology.h"
+
+#include <ctype.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYS_NODE_DIR "/sys/devices/system/node"
+
+int topology_parse_list(const char* list, int* ids, int max) {
+  int n = 0;
+  const char* p = list;
+
+  while (*p && *p != '\n') {
+    char* end;
+    long lo = strtol(p, &end, 10);
+    if (end == p || lo < 0) {
+      return -1;
+    }
+    long hi = lo;
+    p = end;
+    if (*p == '-') {
+      hi = strtol(p + 1, &end, 10);
+      if (end == p + 1 || hi < lo) {
+        return -1;
+      }
+      p = end;
+    }
+    for (long i = lo; i <= hi && n < max; i++) {
+      ids[n++] = i;
+    }
+    if (*p == ',') {
+      p++;
+    } else if (*p && *p != '\n' && !isspace((unsigned char)*p)) {
+      return -1;
+    }
+  }
+  return n;
+}
+
+// Lire une liste de /sys; retourne -1 si le fichier n'existe pas
+static int read_sys_list(const char* path, int* ids, int max) {
+  FILE* file = fopen(path, "r");
+  if (!file) {
+    return -1;
+  }
+  char buf[4096];
+  int n = -1;
+  if (fgets(buf, sizeof(buf), file)) {
+    n = topology_parse_list(buf, ids, max);
+  }
+  fclose(file);
+  return n;
+}
+
+int topology_init(struct topology* topo) {
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+    perror("sched_getaffinity");
+    return -1;
+  }
+
+  topo->nb_nodes = 0;
+  topo->nb_cpus = 0;
+  topo->nb_cpu_ids = CPU_SETSIZE;
+  topo->cpus = malloc(CPU_SETSIZE * sizeof(int));
+  topo->node_first = malloc((CPU_SETSIZE + 1) * sizeof(int));
+  topo->cpu_node = malloc(CPU_SETSIZE * sizeof(int));
+  int* node_ids = malloc(CPU_SETSIZE * sizeof(int));
+  int* node_cpus = malloc(CPU_SETSIZE * sizeof(int));
+  if (!topo->cpus || !topo->node_first || !topo->cpu_node || !node_ids ||
+      !node_cpus) {
+    perror("malloc");
+    free(node_ids);
+    free(node_cpus);
+    topology_destroy(topo);
+    return -1;
+  }
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    topo->cpu_node[cpu] = -1;
+  }
+
+  int nb_node_ids = read_sys_list(SYS_NODE_DIR "/online", node_ids,
+                                  CPU_SETSIZE);
+  for (int i = 0; i < nb_node_ids; i++) {
+    char path[128];
+    snprintf(path, sizeof(path), SYS_NODE_DIR "/node%d/cpulist", node_ids[i]);
+    int nb = read_sys_list(path, node_cpus, CPU_SETSIZE);
+
+    int first = topo->nb_cpus;
+    for (int k = 0; k < nb; k++) {
+      int cpu = node_cpus[k];
+      if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed) &&
+          topo->cpu_node[cpu] < 0) {
+        topo->cpu_node[cpu] = topo->nb_nodes;
+        topo->cpus[topo->nb_cpus++] = cpu;
+      }
+    }
+    if (topo->nb_cpus > first) {
+      topo->node_first[topo->nb_nodes++] = first;
+    }
+  }
+
+  // Processeurs absents de /sys: un noeud de plus, ou l'unique noeud
+  int first = topo->nb_cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed) && topo->cpu_node[cpu] < 0) {
+      topo->cpu_node[cpu] = topo->nb_nodes;
+      topo->cpus[topo->nb_cpus++] = cpu;
+    }
+  }
+  if (topo->nb_cpus > first) {
+    topo->node_first[topo->nb_nodes++] = first;
+  }
+  topo->node_first[topo->nb_nodes] = topo->nb_cpus;
+
+  free(node_ids);
+  free(node_cpus);
+  return 0;
+}
+
+void topology_destroy(struct topology* topo) {
+  free(topo->cpus);
+  free(topo->node_first);
+  free(topo->cpu_node);
+  topo->cpus = NULL;
+  topo->node_first = NULL;
+  topo->cpu_node = NULL;
+}
+
+int topology_cpu_node(const struct topology* topo, int cpu) {
+  if (cpu < 0 || cpu >= topo->nb_cpu_ids || topo->cpu_node[cpu] < 0) {
+    return 0;
+  }
+  return topo->cpu_node[cpu];
+}
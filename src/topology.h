@@ -0,0 +1,40 @@
+#ifndef INF3170_TOPOLOGY_H_
+#define INF3170_TOPOLOGY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Processeurs utilisables par le processus (sched_getaffinity), groupés par
+ * noeud NUMA d'après /sys/devices/system/node. Les noeuds sans processeur
+ * utilisable sont ignorés et les noeuds restants sont numérotés à partir de 0.
+ * Sans /sys, tous les processeurs forment un seul noeud.
+ */
+struct topology {
+  int nb_nodes;
+  int nb_cpus;
+  int *cpus;        // ceux du noeud 0, puis ceux du noeud 1, etc.
+  int *node_first;  // indice dans cpus du premier processeur de chaque noeud,
+                    // nb_nodes + 1 entrées
+  int nb_cpu_ids;
+  int *cpu_node;  // noeud de chaque numéro de processeur, -1 si inutilisable
+};
+
+int topology_init(struct topology *topo);
+void topology_destroy(struct topology *topo);
+
+// Noeud du processeur cpu, 0 s'il est inconnu
+int topology_cpu_node(const struct topology *topo, int cpu);
+
+/*
+ * Lire une liste au format de /sys ("0-3,8,10-11") dans ids, au plus max
+ * entrées. Retourne le nombre d'entrées, ou -1 si la liste est invalide.
+ */
+int topology_parse_list(const char *list, int *ids, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
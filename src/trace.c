@@ -0,0 +1,223 @@
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct trace_event {
+  uint64_t ns;
+  const char* name;
+  uint8_t kind;
+  char phase;  // 'B' ou 'E', comme dans le format de Chrome
+};
+
+// Tampon d'un thread: un seul écrivain, lu pendant l'écriture de la trace
+struct trace_buffer {
+  struct trace_buffer* next;
+  int tid;
+  uint64_t head;  // événements écrits depuis le début
+  struct trace_event events[TRACE_BUFFER_EVENTS];
+};
+
+// Changement du nombre de threads actifs
+struct trace_step {
+  uint64_t ns;
+  int delta;
+};
+
+int trace_enabled;
+
+static struct trace_buffer* trace_buffers;
+// Incrémenté quand les tampons sont libérés: les pointeurs locaux des threads
+// d'une trace précédente ne sont plus valides
+static unsigned int trace_generation;
+static int trace_next_tid;
+static uint64_t trace_t0;
+
+static __thread struct trace_buffer* local_buffer;
+static __thread unsigned int local_generation;
+
+static const char* const kind_names[TRACE_NB_KINDS] = {"task", "filter", "io"};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Tampon du thread appelant, alloué à son premier événement
+static struct trace_buffer* trace_local(void) {
+  unsigned int generation =
+      __atomic_load_n(&trace_generation, __ATOMIC_ACQUIRE);
+  if (local_buffer && local_generation == generation) {
+    return local_buffer;
+  }
+
+  struct trace_buffer* buffer = malloc(sizeof(struct trace_buffer));
+  if (!buffer) {
+    perror("malloc");
+    __atomic_store_n(&trace_enabled, 0, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  buffer->tid = __atomic_fetch_add(&trace_next_tid, 1, __ATOMIC_RELAXED);
+  buffer->head = 0;
+  buffer->next = __atomic_load_n(&trace_buffers, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&trace_buffers, &buffer->next, buffer, 1,
+                                      __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+  }
+  local_buffer = buffer;
+  local_generation = generation;
+  return buffer;
+}
+
+void trace_record(enum trace_kind kind, const char* name, char phase) {
+  struct trace_buffer* buffer = trace_local();
+  if (!buffer) {
+    return;
+  }
+  uint64_t head = buffer->head;
+  struct trace_event* event =
+      &buffer->events[head & (TRACE_BUFFER_EVENTS - 1)];
+  event->ns = now_ns();
+  event->name = name;
+  event->kind = kind;
+  event->phase = phase;
+  __atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void trace_clear(void) {
+  struct trace_buffer* buffer =
+      __atomic_exchange_n(&trace_buffers, NULL, __ATOMIC_ACQ_REL);
+  while (buffer) {
+    struct trace_buffer* next = buffer->next;
+    free(buffer);
+    buffer = next;
+  }
+  trace_next_tid = 0;
+  __atomic_add_fetch(&trace_generation, 1, __ATOMIC_RELEASE);
+}
+
+void trace_start(void) {
+  trace_clear();
+  trace_t0 = now_ns();
+  __atomic_store_n(&trace_enabled, 1, __ATOMIC_RELEASE);
+}
+
+void trace_stop(void) {
+  __atomic_store_n(&trace_enabled, 0, __ATOMIC_RELEASE);
+}
+
+// Premier événement encore présent dans le tampon
+static uint64_t trace_first(uint64_t head) {
+  return head > TRACE_BUFFER_EVENTS ? head - TRACE_BUFFER_EVENTS : 0;
+}
+
+static double trace_seconds(uint64_t ns) {
+  return ns > trace_t0 ? (ns - trace_t0) * 1e-9 : 0.0;
+}
+
+static int step_cmp(const void* a, const void* b) {
+  uint64_t na = ((const struct trace_step*)a)->ns;
+  uint64_t nb = ((const struct trace_step*)b)->ns;
+  return (na > nb) - (na < nb);
+}
+
+int trace_write_active(FILE* out) {
+  size_t capacity = 0;
+  struct trace_buffer* buffers =
+      __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE);
+  for (struct trace_buffer* b = buffers; b; b = b->next) {
+    capacity += TRACE_BUFFER_EVENTS;
+  }
+  struct trace_step* steps = malloc((capacity ? capacity : 1) *
+                                    sizeof(struct trace_step));
+  if (!steps) {
+    perror("malloc");
+    return -1;
+  }
+
+  // Un thread devient actif en entrant dans sa tâche la plus externe. Une fin
+  // dont le début a été écrasé est ignorée.
+  size_t nb_steps = 0;
+  for (struct trace_buffer* b = buffers; b; b = b->next) {
+    uint64_t head = __atomic_load_n(&b->head, __ATOMIC_ACQUIRE);
+    int depth = 0;
+    for (uint64_t i = trace_first(head); i < head; i++) {
+      struct trace_event* e = &b->events[i & (TRACE_BUFFER_EVENTS - 1)];
+      if (e->kind != TRACE_TASK) {
+        continue;
+      }
+      if (e->phase == 'B' && depth++ == 0) {
+        steps[nb_steps++] = (struct trace_step){e->ns, 1};
+      } else if (e->phase == 'E' && depth > 0 && --depth == 0) {
+        steps[nb_steps++] = (struct trace_step){e->ns, -1};
+      }
+    }
+  }
+  qsort(steps, nb_steps, sizeof(struct trace_step), step_cmp);
+
+  int active = 0;
+  fprintf(out, "# temps actif\n");
+  fprintf(out, "%.18e %d\n", 0.0, active);
+  for (size_t i = 0; i < nb_steps; i++) {
+    active += steps[i].delta;
+    fprintf(out, "%.18e %d\n", trace_seconds(steps[i].ns), active);
+  }
+  free(steps);
+  return ferror(out) ? -1 : 0;
+}
+
+int trace_write_json(FILE* out) {
+  const char* sep = "";
+  fprintf(out, "{\"traceEvents\":[\n");
+  for (struct trace_buffer* b =
+           __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE);
+       b; b = b->next) {
+    uint64_t head = __atomic_load_n(&b->head, __ATOMIC_ACQUIRE);
+    for (uint64_t i = trace_first(head); i < head; i++) {
+      struct trace_event* e = &b->events[i & (TRACE_BUFFER_EVENTS - 1)];
+      // ts en microsecondes
+      fprintf(out,
+              "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+              "\"pid\":1,\"tid\":%d}",
+              sep, e->name, kind_names[e->kind], e->phase,
+              trace_seconds(e->ns) * 1e6, b->tid);
+      sep = ",\n";
+    }
+  }
+  fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+  return ferror(out) ? -1 : 0;
+}
+
+static int trace_write_file(const char* prefix, const char* ext,
+                            int (*write)(FILE*)) {
+  char* path = malloc(strlen(prefix) + strlen(ext) + 1);
+  if (!path) {
+    perror("malloc");
+    return -1;
+  }
+  strcpy(path, prefix);
+  strcat(path, ext);
+
+  int ret = -1;
+  FILE* out = fopen(path, "w");
+  if (!out) {
+    perror(path);
+  } else {
+    ret = write(out);
+    if (fclose(out) != 0) {
+      ret = -1;
+    }
+  }
+  free(path);
+  return ret;
+}
+
+int trace_dump(const char* prefix) {
+  trace_stop();
+  int ret = trace_write_file(prefix, ".txt", trace_write_active);
+  if (trace_write_file(prefix, ".json", trace_write_json) < 0) {
+    ret = -1;
+  }
+  return ret;
+}
@@ -0,0 +1,74 @@
+#ifndef INF3170_TRACE_H_
+#define INF3170_TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Enregistreur de traces d'exécution.
+ *
+ * Chaque thread écrit ses événements dans son propre tampon circulaire, sans
+ * verrou; quand le tampon est plein, les plus anciens sont écrasés. Tant que la
+ * trace est désactivée, un point de trace coûte une lecture et un branchement.
+ *
+ * Les intervalles TRACE_TASK (tâches d'un pool, étages du pipeline) donnent le
+ * nombre de threads actifs; les intervalles imbriqués dans une tâche ne
+ * comptent qu'une fois. Le nom d'un intervalle doit rester valide jusqu'à
+ * l'écriture de la trace, par exemple une chaîne littérale.
+ *
+ * trace_start() et trace_dump() ne doivent être appelées que lorsque les
+ * threads tracés sont terminés ou au repos, par exemple après
+ * threadpool_wait().
+ */
+
+enum trace_kind {
+  TRACE_TASK,    // tâche d'un pool ou étage du pipeline
+  TRACE_FILTER,  // filtre appliqué à une image
+  TRACE_IO,      // décodage ou encodage PNG
+  TRACE_NB_KINDS,
+};
+
+// Événements gardés par thread, une puissance de deux
+#define TRACE_BUFFER_EVENTS 16384
+
+extern int trace_enabled;
+
+void trace_record(enum trace_kind kind, const char *name, char phase);
+
+static inline void trace_begin(enum trace_kind kind, const char *name) {
+  if (__builtin_expect(__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED), 0)) {
+    trace_record(kind, name, 'B');
+  }
+}
+
+static inline void trace_end(enum trace_kind kind, const char *name) {
+  if (__builtin_expect(__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED), 0)) {
+    trace_record(kind, name, 'E');
+  }
+}
+
+// Effacer la trace précédente et commencer à enregistrer; le temps 0 est ici
+void trace_start(void);
+void trace_stop(void);
+
+/*
+ * Série « temps actif » lue par trace/log.gnuplot: une ligne par changement,
+ * le temps en secondes depuis trace_start() et le nombre de threads actifs.
+ */
+int trace_write_active(FILE *out);
+
+// Format Trace Event de Chrome, pour chrome://tracing ou Perfetto
+int trace_write_json(FILE *out);
+
+// Arrêter la trace et écrire <prefix>.txt et <prefix>.json
+int trace_dump(const char *prefix);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ * Banc d'essai du décodage PNG.
+ *
+ * Compare image_create_from_png(), qui décode directement dans image->pixels,
+ * à l'ancien chemin (rows): une allocation par ligne, décodage dans ces
+ * lignes, puis copie pixel par pixel dans l'image. Le débit est celui des
+ * pixels RGBA produits. Sans fichier, une image synthétique de width x height
+ * est générée dans /tmp.
+ *
+ * Usage: bench_decode [repeat] [width] [height] [file.png]
+ */
+
+#include <png.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "image.h"
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int make_png(const char* fname, size_t width, size_t height) {
+  image_t* img = image_create(0, width, height);
+  if (!img) {
+    return -1;
+  }
+  unsigned int seed = width * 31 + height;
+  for (size_t j = 0; j < height; j++) {
+    for (size_t i = 0; i < width; i++) {
+      pixel_t* pixel = image_get_pixel(img, i, j);
+      pixel->bytes[0] = i + (rand_r(&seed) & 15);
+      pixel->bytes[1] = j + (rand_r(&seed) & 15);
+      pixel->bytes[2] = (i ^ j) & 0xff;
+      pixel->bytes[3] = 0xff;
+    }
+  }
+  int ret = image_save_png(img, fname);
+  image_destroy(img);
+  return ret;
+}
+
+// Ancien décodage, gardé comme référence: lignes allouées puis copiées
+static image_t* decode_rows(const char* fname) {
+  FILE* file = fopen(fname, "rb");
+  if (!file) {
+    perror("fopen");
+    return NULL;
+  }
+  png_structp png =
+      png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info = png_create_info_struct(png);
+  image_t* volatile image = NULL;
+  png_bytep* volatile rows = NULL;
+  if (setjmp(png_jmpbuf(png))) {
+    goto out;
+  }
+  png_init_io(png, file);
+  png_read_info(png, info);
+
+  png_byte color = png_get_color_type(png, info);
+  png_byte depth = png_get_bit_depth(png, info);
+  if (depth == 16) {
+    png_set_strip_16(png);
+  }
+  if (color == PNG_COLOR_TYPE_PALETTE) {
+    png_set_palette_to_rgb(png);
+  }
+  if (color == PNG_COLOR_TYPE_GRAY && depth < 8) {
+    png_set_expand_gray_1_2_4_to_8(png);
+  }
+  if (png_get_valid(png, info, PNG_INFO_tRNS)) {
+    png_set_tRNS_to_alpha(png);
+  }
+  if (color == PNG_COLOR_TYPE_RGB || color == PNG_COLOR_TYPE_GRAY ||
+      color == PNG_COLOR_TYPE_PALETTE) {
+    png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
+  }
+  if (color == PNG_COLOR_TYPE_GRAY || color == PNG_COLOR_TYPE_GRAY_ALPHA) {
+    png_set_gray_to_rgb(png);
+  }
+  png_read_update_info(png, info);
+
+  image = image_create(0, png_get_image_width(png, info),
+                       png_get_image_height(png, info));
+  rows = calloc(image->height, sizeof(*rows));
+  for (size_t j = 0; j < image->height; j++) {
+    rows[j] = malloc(png_get_rowbytes(png, info));
+  }
+  png_read_image(png, rows);
+  for (size_t j = 0; j < image->height; j++) {
+    for (size_t i = 0; i < image->width; i++) {
+      pixel_t* pixel = image_get_pixel(image, i, j);
+      for (int k = 0; k < 4; k++) {
+        pixel->bytes[k] = rows[j][4 * i + k];
+      }
+    }
+  }
+
+out:
+  if (rows) {
+    for (size_t j = 0; j < image->height; j++) {
+      free(rows[j]);
+    }
+    free(rows);
+  }
+  png_destroy_read_struct(&png, &info, NULL);
+  fclose(file);
+  return image;
+}
+
+struct decoder {
+  const char* name;
+  image_t* (*decode)(const char* fname);
+};
+
+static const struct decoder decoders[] = {
+    {"rows", decode_rows},
+    {"direct", image_create_from_png},
+};
+
+int main(int argc, char** argv) {
+  int repeat = argc > 1 ? atoi(argv[1]) : 20;
+  size_t width = argc > 2 ? atol(argv[2]) : 2048;
+  size_t height = argc > 3 ? atol(argv[3]) : 2048;
+  const char* fname = argc > 4 ? argv[4] : NULL;
+  if (repeat < 1 || width < 1 || height < 1) {
+    fprintf(stderr, "usage: %s [repeat] [width] [height] [file.png]\n",
+            argv[0]);
+    return 1;
+  }
+
+  char tmp[] = "/tmp/bench_decode.XXXXXX";
+  if (!fname) {
+    int fd = mkstemp(tmp);
+    if (fd < 0) {
+      perror("mkstemp");
+      return 1;
+    }
+    close(fd);
+    if (make_png(tmp, width, height) < 0) {
+      fprintf(stderr, "failed to create %s\n", tmp);
+      unlink(tmp);
+      return 1;
+    }
+    fname = tmp;
+  }
+
+  printf("%-8s %10s %10s %10s\n", "decoder", "Mpixels", "time (s)", "MB/s");
+  for (size_t d = 0; d < sizeof(decoders) / sizeof(decoders[0]); d++) {
+    // Un décodage pour réchauffer le cache de fichiers et la réserve de tampons
+    image_destroy(decoders[d].decode(fname));
+
+    size_t pixels = 0;
+    double start = now();
+    for (int r = 0; r < repeat; r++) {
+      image_t* img = decoders[d].decode(fname);
+      if (!img) {
+        return 1;
+      }
+      pixels += img->width * img->height;
+      image_destroy(img);
+    }
+    double elapsed = now() - start;
+    printf("%-8s %10.2f %10.3f %10.1f\n", decoders[d].name, pixels * 1e-6,
+           elapsed, pixels * sizeof(pixel_t) / elapsed * 1e-6);
+  }
+
+  if (fname == tmp) {
+    unlink(tmp);
+  }
+  return 0;
+}
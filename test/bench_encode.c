@@ -0,0 +1,160 @@
+/*
+ * Banc d'essai de l'encodage PNG: taille et vitesse selon les réglages.
+ *
+ * L'image encodée est la sortie de la chaîne de filtres appliquée au fichier
+ * d'entrée, comme les fichiers écrits par ieffect. La première ligne (copy)
+ * est l'ancien encodage, qui copiait chaque pixel dans des lignes allouées
+ * avant de les passer à libpng; les autres passent par image_save_png_opts().
+ * Le débit est celui des pixels RGBA encodés.
+ *
+ * Usage: bench_encode [repeat] [file.png]
+ */
+
+#include <png.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "config.h"
+#include "image.h"
+#include "processing.h"
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Ancien encodage, gardé comme référence: réglages de libpng et copie
+static int save_copy(image_t* image, const char* fname) {
+  FILE* file = fopen(fname, "wb");
+  if (!file) {
+    perror("fopen");
+    return -1;
+  }
+  png_structp png =
+      png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info = png_create_info_struct(png);
+  png_bytep* volatile rows = NULL;
+  volatile int ret = -1;
+  if (setjmp(png_jmpbuf(png))) {
+    goto out;
+  }
+  png_init_io(png, file);
+  png_set_IHDR(png, info, image->width, image->height, 8, PNG_COLOR_TYPE_RGBA,
+               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+               PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png, info);
+
+  rows = calloc(image->height, sizeof(*rows));
+  for (size_t j = 0; j < image->height; j++) {
+    rows[j] = malloc(png_get_rowbytes(png, info));
+    for (size_t i = 0; i < image->width; i++) {
+      pixel_t* pixel = image_get_pixel(image, i, j);
+      for (int k = 0; k < 4; k++) {
+        rows[j][4 * i + k] = pixel->bytes[k];
+      }
+    }
+  }
+  png_write_image(png, rows);
+  png_write_end(png, NULL);
+  ret = 0;
+
+out:
+  if (rows) {
+    for (size_t j = 0; j < image->height; j++) {
+      free(rows[j]);
+    }
+    free(rows);
+  }
+  png_destroy_write_struct(&png, &info);
+  fclose(file);
+  return ret;
+}
+
+struct setting {
+  const char* name;
+  image_png_opts_t opts;
+};
+
+static const struct setting settings[] = {
+    {"default", {Z_DEFAULT_COMPRESSION, -1, -1, 0}},
+    {"l9", {9, -1, -1, 0}},
+    {"l1", {1, -1, -1, 0}},
+    {"l1-sub", {1, Z_DEFAULT_STRATEGY, PNG_FILTER_SUB, 0}},
+    {"l1-none", {1, Z_DEFAULT_STRATEGY, PNG_FILTER_NONE, 0}},
+    {"rle-sub", {1, Z_RLE, PNG_FILTER_SUB, 0}},
+    {"rle-up", {1, Z_RLE, PNG_FILTER_UP, 0}},
+    {"rle-paeth", {1, Z_RLE, PNG_FILTER_PAETH, 0}},
+    {"huffman", {1, Z_HUFFMAN_ONLY, PNG_FILTER_SUB, 0}},
+    {"rle-256k", {1, Z_RLE, PNG_FILTER_SUB, 256 << 10}},
+    {"store", {0, Z_DEFAULT_STRATEGY, PNG_FILTER_NONE, 0}},
+};
+
+static void report(const char* name, double elapsed, int repeat,
+                   image_t* img, const char* fname) {
+  struct stat st;
+  if (stat(fname, &st) < 0) {
+    perror("stat");
+    exit(1);
+  }
+  size_t raw = img->width * img->height * sizeof(pixel_t);
+  printf("%-10s %10.3f %10.1f %12ld %8.3f\n", name, elapsed / repeat * 1e3,
+         raw * repeat / elapsed * 1e-6, (long)st.st_size,
+         (double)st.st_size / raw);
+}
+
+int main(int argc, char** argv) {
+  int repeat = argc > 1 ? atoi(argv[1]) : 5;
+  const char* input = argc > 2 ? argv[2] : SOURCE_DIR "/test/cat.png";
+  if (repeat < 1) {
+    fprintf(stderr, "usage: %s [repeat] [file.png]\n", argv[0]);
+    return 1;
+  }
+
+  image_t* img = image_create_from_png(input);
+  if (!img) {
+    return 1;
+  }
+  img = process_apply_filters(img, NULL);
+  if (!img) {
+    return 1;
+  }
+
+  char fname[] = "/tmp/bench_encode.XXXXXX";
+  int fd = mkstemp(fname);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+
+  printf("%zux%zu\n", img->width, img->height);
+  printf("%-10s %10s %10s %12s %8s\n", "setting", "time (ms)", "MB/s",
+         "bytes", "ratio");
+
+  double start = now();
+  for (int r = 0; r < repeat; r++) {
+    if (save_copy(img, fname) < 0) {
+      return 1;
+    }
+  }
+  report("copy", now() - start, repeat, img, fname);
+
+  for (size_t s = 0; s < sizeof(settings) / sizeof(settings[0]); s++) {
+    start = now();
+    for (int r = 0; r < repeat; r++) {
+      if (image_save_png_opts(img, fname, &settings[s].opts) < 0) {
+        return 1;
+      }
+    }
+    report(settings[s].name, now() - start, repeat, img, fname);
+  }
+
+  unlink(fname);
+  image_destroy(img);
+  return 0;
+}
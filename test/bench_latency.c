@@ -0,0 +1,126 @@
+/*
+ * Banc d'essai de la latence de démarrage des tâches selon la politique
+ * d'attente des travailleurs (enum threadpool_idle).
+ *
+ * Charge en rafales: nb_bursts rafales de burst petites tâches, séparées par
+ * une pause de gap microsecondes pendant laquelle les travailleurs n'ont rien à
+ * faire. La latence est mesurée du dépôt de la tâche au début de son exécution;
+ * elle comprend donc le réveil d'un travailleur endormi. Le temps processeur
+ * consommé par le processus montre le coût de l'attente active.
+ *
+ * Usage: bench_latency [nb_bursts] [burst] [gap_us] [max_threads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/sysinfo.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "threadpool.h"
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double cpu_time(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct sample {
+  double submitted;
+  double latency;
+};
+
+static void* sample_task(void* arg) {
+  struct sample* s = arg;
+  s->latency = now() - s->submitted;
+  return NULL;
+}
+
+static int cmp_latency(const void* a, const void* b) {
+  double la = ((const struct sample*)a)->latency;
+  double lb = ((const struct sample*)b)->latency;
+  return (la > lb) - (la < lb);
+}
+
+struct policy {
+  const char* name;
+  enum threadpool_idle idle;
+  unsigned int spin;
+};
+
+static const struct policy policies[] = {
+    {"block", THREADPOOL_IDLE_BLOCK, 0},
+    {"futex", THREADPOOL_IDLE_SPIN, 0},
+    {"spin", THREADPOOL_IDLE_SPIN, THREADPOOL_SPIN},
+    {"spin-long", THREADPOOL_IDLE_SPIN, 16 * THREADPOOL_SPIN},
+};
+
+static void run(int nb_threads, const struct policy* policy, int nb_bursts,
+                int burst, int gap_us) {
+  size_t nb_samples = (size_t)nb_bursts * burst;
+  struct sample* samples = calloc(nb_samples, sizeof(*samples));
+  if (!samples) {
+    perror("calloc");
+    exit(1);
+  }
+
+  struct pool_attr attr;
+  threadpool_attr_init(&attr, nb_threads);
+  attr.idle = policy->idle;
+  attr.spin = policy->spin;
+  struct pool* pool = threadpool_create_attr(&attr);
+  if (!pool) {
+    exit(1);
+  }
+
+  double cpu = cpu_time();
+  double start = now();
+  for (int b = 0; b < nb_bursts; b++) {
+    for (int i = 0; i < burst; i++) {
+      struct sample* s = &samples[(size_t)b * burst + i];
+      s->submitted = now();
+      threadpool_add_task(pool, sample_task, s);
+    }
+    threadpool_wait(pool);
+    usleep(gap_us);
+  }
+  double elapsed = now() - start;
+  cpu = cpu_time() - cpu;
+  threadpool_join(pool);
+
+  qsort(samples, nb_samples, sizeof(samples[0]), cmp_latency);
+  printf("%-10s %8d %12.1f %12.1f %10.2f\n", policy->name, nb_threads,
+         samples[nb_samples / 2].latency * 1e6,
+         samples[nb_samples * 99 / 100].latency * 1e6, cpu / elapsed);
+  free(samples);
+}
+
+int main(int argc, char** argv) {
+  int nb_bursts = argc > 1 ? atoi(argv[1]) : 200;
+  int burst = argc > 2 ? atoi(argv[2]) : 8;
+  int gap_us = argc > 3 ? atoi(argv[3]) : 200;
+  int max_threads = argc > 4 ? atoi(argv[4]) : get_nprocs();
+  if (nb_bursts < 1 || burst < 1) {
+    fprintf(stderr, "usage: %s [nb_bursts] [burst] [gap_us] [max_threads]\n",
+            argv[0]);
+    return 1;
+  }
+
+  printf("%-10s %8s %12s %12s %10s\n", "idle", "threads", "p50 (us)",
+         "p99 (us)", "cpu/wall");
+  for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+    for (int n = 1;; n = n * 2 < max_threads ? n * 2 : max_threads) {
+      run(n, &policies[p], nb_bursts, burst, gap_us);
+      if (n == max_threads) {
+        break;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,109 @@
+#define _GNU_SOURCE
+/*
+ * Banc d'essai de la bande passante mémoire locale et distante des filtres.
+ *
+ * Pour chaque paire de noeuds NUMA (source, calcul), l'image est allouée et
+ * remplie par un thread épinglé sur le noeud source (la première écriture
+ * place les pages), puis chaque filtre est exécuté par un thread épinglé sur
+ * le noeud de calcul. Les lignes où source == calcul sont les accès locaux.
+ * Le débit compte les octets lus et écrits par le filtre.
+ *
+ * Usage: bench_numa [width] [height] [repeat]
+ */
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "filter.h"
+#include "image.h"
+#include "topology.h"
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct kernel {
+  const char* name;
+  image_t* (*fn)(image_t* img);
+};
+
+static const struct kernel kernels[] = {
+    {"desaturate", filter_desaturate},
+    {"gaussian_blur", filter_gaussian_blur},
+    {"horizontal_flip", filter_horizontal_flip},
+};
+
+// Épingler le thread courant sur les processeurs d'un noeud
+static void bind_node(const struct topology* topo, int node) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int i = topo->node_first[node]; i < topo->node_first[node + 1]; i++) {
+    CPU_SET(topo->cpus[i], &set);
+  }
+  if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+    perror("sched_setaffinity");
+    exit(1);
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t width = argc > 1 ? atol(argv[1]) : 4096;
+  size_t height = argc > 2 ? atol(argv[2]) : 4096;
+  int repeat = argc > 3 ? atoi(argv[3]) : 3;
+
+  struct topology topo;
+  if (topology_init(&topo) < 0) {
+    return 1;
+  }
+  printf("%d node(s), %d cpu(s), image %zux%zu\n", topo.nb_nodes, topo.nb_cpus,
+         width, height);
+  if (topo.nb_nodes == 1) {
+    printf("single node: only local bandwidth is measured\n");
+  }
+
+  printf("%-16s %6s %6s %10s\n", "filter", "source", "run", "GB/s");
+  for (int src = 0; src < topo.nb_nodes; src++) {
+    bind_node(&topo, src);
+    image_t* img = image_create(0, width, height);
+    if (!img) {
+      return 1;
+    }
+    for (size_t i = 0; i < width * height; i++) {
+      img->pixels[i].bytes[0] = i;
+      img->pixels[i].bytes[1] = i >> 8;
+      img->pixels[i].bytes[2] = i >> 16;
+      img->pixels[i].bytes[3] = 0xff;
+    }
+
+    for (int run = 0; run < topo.nb_nodes; run++) {
+      bind_node(&topo, run);
+      for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        double best = 0;
+        for (int r = 0; r < repeat; r++) {
+          double start = now();
+          image_t* out = kernels[k].fn(img);
+          double elapsed = now() - start;
+          if (!out) {
+            return 1;
+          }
+          double bytes = (double)(width * height + out->width * out->height) *
+                         sizeof(pixel_t);
+          if (bytes / elapsed > best) {
+            best = bytes / elapsed;
+          }
+          image_destroy(out);
+        }
+        printf("%-16s %6d %6d %10.2f\n", kernels[k].name, src, run,
+               best * 1e-9);
+      }
+    }
+    image_destroy(img);
+  }
+
+  topology_destroy(&topo);
+  return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Banc d'essai de la compression PNG répartie sur un pool (pngpar.h).
+ *
+ * L'image de test est agrandie scale fois puis floutée, pour une image lisse
+ * comme une photo; scale 11 donne une image de plus de 8K de large. Elle est
+ * écrite une fois par libpng (image_save_png_opts, un seul coeur), puis par
+ * pngpar_save() avec 1, 2, 4, ... max_threads travailleurs.
+ *
+ * Usage: bench_pngpar [max_threads] [scale] [level]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/sysinfo.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "filter.h"
+#include "image.h"
+#include "pngpar.h"
+#include "threadpool.h"
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long file_size(const char* fname) {
+  struct stat st;
+  return stat(fname, &st) < 0 ? -1 : (long)st.st_size;
+}
+
+int main(int argc, char** argv) {
+  int max_threads = argc > 1 ? atoi(argv[1]) : get_nprocs();
+  int scale = argc > 2 ? atoi(argv[2]) : 11;
+  int level = argc > 3 ? atoi(argv[3]) : -1;
+  if (max_threads < 1 || scale < 1 || level < -1 || level > 9) {
+    fprintf(stderr, "usage: %s [max_threads] [scale] [level]\n", argv[0]);
+    return 1;
+  }
+
+  image_t* cat = image_create_from_png(SOURCE_DIR "/test/cat.png");
+  if (!cat) {
+    return 1;
+  }
+  struct pool* pool = threadpool_create(max_threads);
+  image_t* big = filter_scale_up_mt(pool, cat, scale);
+  image_t* img = big ? filter_gaussian_blur_mt(pool, big) : NULL;
+  threadpool_join(pool);
+  image_destroy(cat);
+  image_destroy(big);
+  if (!img) {
+    return 1;
+  }
+
+  char fname[] = "/tmp/bench_pngpar.XXXXXX";
+  int fd = mkstemp(fname);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+
+  image_png_opts_t opts;
+  image_png_opts_init(&opts);
+  opts.level = level;
+
+  double mb = img->width * img->height * sizeof(pixel_t) * 1e-6;
+  printf("%zux%zu, %.1f MB\n", img->width, img->height, mb);
+  printf("%-8s %8s %10s %10s %8s %12s\n", "writer", "threads", "time (s)",
+         "MB/s", "speedup", "bytes");
+
+  double start = now();
+  if (image_save_png_opts(img, fname, &opts) < 0) {
+    return 1;
+  }
+  double serial = now() - start;
+  printf("%-8s %8d %10.3f %10.1f %8.2f %12ld\n", "libpng", 1, serial,
+         mb / serial, 1.0, file_size(fname));
+
+  for (int n = 1;; n = n * 2 < max_threads ? n * 2 : max_threads) {
+    pool = threadpool_create(n);
+    start = now();
+    if (pngpar_save(pool, img, fname, &opts) < 0) {
+      return 1;
+    }
+    double elapsed = now() - start;
+    threadpool_join(pool);
+    printf("%-8s %8d %10.3f %10.1f %8.2f %12ld\n", "pngpar", n, elapsed,
+           mb / elapsed, serial / elapsed, file_size(fname));
+    if (n == max_threads) {
+      break;
+    }
+  }
+
+  unlink(fname);
+  image_destroy(img);
+  return 0;
+}
@@ -0,0 +1,133 @@
+#define _GNU_SOURCE
+/*
+ * Banc d'essai de la répartition des threads entre les images et les lignes.
+ *
+ * Génère trois lots d'images PNG synthétiques dans un répertoire temporaire:
+ *  - huge: quelques très grandes images;
+ *  - thumbs: beaucoup de vignettes;
+ *  - mixed: une grande image et des vignettes.
+ * Chaque lot est traité avec une image par tâche (never), les lignes de chaque
+ * image découpées sur le pool (always) et la répartition automatique (auto).
+ * Les messages de process_on_pool_opts() vont sur stdout, les résultats sur
+ * stderr.
+ *
+ * Usage: bench_processing [nb_threads] [scale]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/sysinfo.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "image.h"
+#include "processing.h"
+#include "threadpool.h"
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct mix {
+  const char* name;
+  int nb_large;
+  int nb_small;
+};
+
+static const struct mix mixes[] = {
+    {"huge", 3, 0},
+    {"thumbs", 0, 500},
+    {"mixed", 1, 200},
+};
+
+static const char* split_names[] = {"auto", "never", "always"};
+
+static int make_png(const char* fname, size_t width, size_t height) {
+  image_t* img = image_create(0, width, height);
+  if (!img) {
+    return -1;
+  }
+  unsigned int seed = width * 31 + height;
+  for (size_t j = 0; j < height; j++) {
+    for (size_t i = 0; i < width; i++) {
+      pixel_t* pixel = image_get_pixel(img, i, j);
+      pixel->bytes[0] = i + (rand_r(&seed) & 15);
+      pixel->bytes[1] = j + (rand_r(&seed) & 15);
+      pixel->bytes[2] = (i ^ j) & 0xff;
+      pixel->bytes[3] = 0xff;
+    }
+  }
+  int ret = image_save_png(img, fname);
+  image_destroy(img);
+  return ret;
+}
+
+static void remove_outputs(struct list* items) {
+  struct list_node* node = list_head(items);
+  while (!list_end(node)) {
+    struct work_item* item = node->data;
+    unlink(item->input_file);
+    unlink(item->output_file);
+    node = node->next;
+  }
+}
+
+int main(int argc, char** argv) {
+  int nb_threads = argc > 1 ? atoi(argv[1]) : get_nprocs();
+  int scale = argc > 2 ? atoi(argv[2]) : 1;
+
+  char dir[] = "/tmp/bench_processing.XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+
+  struct pool_attr attr;
+  threadpool_attr_init(&attr, nb_threads);
+  attr.work_stealing = 1;
+  struct pool* pool = threadpool_create_attr(&attr);
+
+  fprintf(stderr, "%-8s %-8s %8s %10s %12s\n", "mix", "split", "threads",
+          "time (s)", "Mpixels/s");
+  for (size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+    struct list* items = list_new(NULL, free_work_item);
+    size_t pixels = 0;
+    for (int i = 0; i < mixes[m].nb_large + mixes[m].nb_small; i++) {
+      int large = i < mixes[m].nb_large;
+      size_t width = large ? 1024 * scale : 96;
+      size_t height = large ? 768 * scale : 64;
+
+      struct work_item* item = calloc(1, sizeof(*item));
+      if (asprintf(&item->input_file, "%s/in-%d.png", dir, i) < 0 ||
+          asprintf(&item->output_file, "%s/out-%d.png", dir, i) < 0 ||
+          make_png(item->input_file, width, height) < 0) {
+        fprintf(stderr, "failed to create %s\n", item->input_file);
+        return 1;
+      }
+      list_push_back(items, list_node_new(item));
+      pixels += width * height;
+    }
+
+    for (enum process_split s = PROCESS_SPLIT_AUTO; s <= PROCESS_SPLIT_ALWAYS;
+         s++) {
+      struct process_opts opts;
+      process_opts_init(&opts);
+      opts.split = s;
+
+      double start = now();
+      process_on_pool_opts(items, pool, &opts);
+      double elapsed = now() - start;
+      fprintf(stderr, "%-8s %-8s %8d %10.3f %12.2f\n", mixes[m].name,
+              split_names[s], nb_threads, elapsed, pixels / elapsed * 1e-6);
+    }
+
+    remove_outputs(items);
+    list_free(items);
+  }
+
+  threadpool_join(pool);
+  rmdir(dir);
+  return 0;
+}
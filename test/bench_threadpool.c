@@ -0,0 +1,186 @@
+/*
+ * Banc d'essai de mise à l'échelle du pool de threads.
+ *
+ * Compare la file partagée (task_list + pool->lock ou anneau sans verrou), avec
+ * et sans vol de tâches, pour deux charges:
+ *  - flat: N petites tâches soumises une à une depuis le thread principal;
+ *  - batch: les mêmes tâches soumises avec threadpool_add_tasks();
+ *  - tree: un arbre binaire de tâches, chaque tâche soumettant ses enfants
+ *    depuis le pool (deque locale en mode vol de tâches).
+ *
+ * Mesure aussi la latence (du dépôt au début de l'exécution) de quelques tâches
+ * urgentes soumises pendant un gros lot, toutes dans la même file (fifo) ou
+ * dans la file prioritaire avec le lot en basse priorité (prio).
+ *
+ * Usage: bench_threadpool [nb_tasks] [max_threads] [spin]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/sysinfo.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "threadpool.h"
+
+static int spin = 200;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void* small_task(void* arg) {
+  volatile int x = 0;
+  for (int i = 0; i < spin; i++) {
+    x += i;
+  }
+  return arg;
+}
+
+enum load { LOAD_FLAT, LOAD_BATCH, LOAD_TREE };
+static const char* load_names[] = {"flat", "batch", "tree"};
+
+struct tree {
+  struct pool* pool;
+  long depth;
+};
+
+static struct tree trees[64];
+
+static void* tree_task(void* arg) {
+  struct tree* t = arg;
+  small_task(NULL);
+  if (t->depth > 0) {
+    threadpool_add_task(t->pool, tree_task, &trees[t->depth - 1]);
+    threadpool_add_task(t->pool, tree_task, &trees[t->depth - 1]);
+  }
+  return NULL;
+}
+
+struct sched {
+  const char* name;
+  int work_stealing;
+  enum threadpool_queue queue;
+};
+
+static const struct sched scheds[] = {
+    {"list", 0, THREADPOOL_QUEUE_LIST},
+    {"ring", 0, THREADPOOL_QUEUE_RING},
+    {"steal", 1, THREADPOOL_QUEUE_LIST},
+    {"steal+ring", 1, THREADPOOL_QUEUE_RING},
+};
+
+// Retourne le débit en millions de tâches par seconde
+static double run(int nb_threads, const struct sched* sched, enum load load,
+                  long nb_tasks) {
+  struct pool_attr attr;
+  threadpool_attr_init(&attr, nb_threads);
+  attr.work_stealing = sched->work_stealing;
+  attr.queue = sched->queue;
+
+  double start = now();
+  struct pool* pool = threadpool_create_attr(&attr);
+  if (load == LOAD_TREE) {
+    long depth = 0;
+    while ((2L << (depth + 1)) - 1 <= nb_tasks) {
+      depth++;
+    }
+    for (long d = 0; d <= depth; d++) {
+      trees[d].pool = pool;
+      trees[d].depth = d;
+    }
+    threadpool_add_task(pool, tree_task, &trees[depth]);
+    nb_tasks = (2L << depth) - 1;
+  } else if (load == LOAD_BATCH) {
+    void** args = calloc(nb_tasks, sizeof(void*));
+    threadpool_add_tasks(pool, small_task, args, nb_tasks);
+    free(args);
+  } else {
+    for (long i = 0; i < nb_tasks; i++) {
+      threadpool_add_task(pool, small_task, NULL);
+    }
+  }
+  threadpool_join(pool);
+  return nb_tasks / (now() - start) * 1e-6;
+}
+
+#define NB_URGENT 200
+
+struct urgent {
+  double submitted;
+  double latency;
+};
+
+static struct urgent urgents[NB_URGENT];
+
+static void* urgent_task(void* arg) {
+  struct urgent* u = arg;
+  u->latency = now() - u->submitted;
+  return NULL;
+}
+
+static int cmp_latency(const void* a, const void* b) {
+  double la = ((const struct urgent*)a)->latency;
+  double lb = ((const struct urgent*)b)->latency;
+  return (la > lb) - (la < lb);
+}
+
+static void run_urgent(int nb_threads, int prio, long nb_tasks) {
+  struct pool* pool = threadpool_create(nb_threads);
+  void** args = calloc(nb_tasks, sizeof(void*));
+
+  double start = now();
+  threadpool_add_tasks_prio(pool,
+                            prio ? THREADPOOL_PRIO_LOW : THREADPOOL_PRIO_NORMAL,
+                            small_task, args, nb_tasks);
+  for (int i = 0; i < NB_URGENT; i++) {
+    urgents[i].submitted = now();
+    threadpool_add_task_prio(
+        pool, prio ? THREADPOOL_PRIO_HIGH : THREADPOOL_PRIO_NORMAL, urgent_task,
+        &urgents[i]);
+    usleep(100);
+  }
+  threadpool_wait(pool);
+  double elapsed = now() - start;
+  threadpool_join(pool);
+  free(args);
+
+  qsort(urgents, NB_URGENT, sizeof(urgents[0]), cmp_latency);
+  printf("%-6s %8d %12.1f %12.1f %14.3f\n", prio ? "prio" : "fifo", nb_threads,
+         urgents[NB_URGENT / 2].latency * 1e6,
+         urgents[NB_URGENT * 99 / 100].latency * 1e6,
+         (nb_tasks + NB_URGENT) / elapsed * 1e-6);
+}
+
+int main(int argc, char** argv) {
+  long nb_tasks = argc > 1 ? atol(argv[1]) : 200000;
+  int max_threads = argc > 2 ? atoi(argv[2]) : get_nprocs();
+  spin = argc > 3 ? atoi(argv[3]) : spin;
+
+  printf("%-6s %-12s %8s %14s\n", "load", "sched", "threads", "Mtasks/s");
+  for (enum load load = LOAD_FLAT; load <= LOAD_TREE; load++) {
+    for (size_t s = 0; s < sizeof(scheds) / sizeof(scheds[0]); s++) {
+      for (int n = 1;; n = n * 2 < max_threads ? n * 2 : max_threads) {
+        printf("%-6s %-12s %8d %14.3f\n", load_names[load], scheds[s].name, n,
+               run(n, &scheds[s], load, nb_tasks));
+        if (n == max_threads) {
+          break;
+        }
+      }
+    }
+  }
+
+  printf("\n%-6s %8s %12s %12s %14s\n", "lanes", "threads", "p50 (us)",
+         "p99 (us)", "Mtasks/s");
+  for (int prio = 0; prio <= 1; prio++) {
+    for (int n = 1;; n = n * 2 < max_threads ? n * 2 : max_threads) {
+      run_urgent(n, prio, nb_tasks);
+      if (n == max_threads) {
+        break;
+      }
+    }
+  }
+  return 0;
+}
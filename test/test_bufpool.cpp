@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "bufpool.h"
+
+static void* alloc_free_main(void* arg) {
+  void* buf = bufpool_alloc(1 << 20);
+  *static_cast<void**>(arg) = buf;
+  bufpool_free(buf);
+  return NULL;
+}
+
+/*
+ * Un tampon libéré est réutilisé pour une taille de la même classe, d'abord
+ * depuis le cache du thread, puis depuis la réserve commune lorsque le thread
+ * qui l'a libéré s'est terminé. Les tampons sont alignés.
+ */
+TEST(BufPool, Recycle) {
+  bufpool_set_limit(BUFPOOL_DEFAULT_LIMIT);
+  struct bufpool_stats before;
+  bufpool_get_stats(&before);
+
+  void* a = bufpool_alloc(100000);
+  ASSERT_TRUE(a != nullptr);
+  EXPECT_EQ((uintptr_t)a % BUFPOOL_ALIGN, 0u);
+  bufpool_free(a);
+  void* b = bufpool_alloc(99000);  // même classe
+  EXPECT_EQ(a, b);
+  bufpool_free(b);
+
+  void* from_thread = nullptr;
+  pthread_t thread;
+  ASSERT_EQ(pthread_create(&thread, NULL, alloc_free_main, &from_thread), 0);
+  pthread_join(thread, NULL);
+  void* c = bufpool_alloc(1 << 20);
+  EXPECT_EQ(c, from_thread);
+
+  // Petits tampons: directement au système, mais alignés aussi
+  void* small = bufpool_alloc(100);
+  ASSERT_TRUE(small != nullptr);
+  EXPECT_EQ((uintptr_t)small % BUFPOOL_ALIGN, 0u);
+  bufpool_free(small);
+
+  struct bufpool_stats after;
+  bufpool_get_stats(&after);
+  EXPECT_EQ(after.allocs - before.allocs, 5u);
+  EXPECT_EQ(after.thread_hits - before.thread_hits, 1u);
+  EXPECT_EQ(after.shared_hits - before.shared_hits, 1u);
+  bufpool_free(c);
+}
+
+// Au-delà de la limite, les tampons libérés sont rendus au système
+TEST(BufPool, Limit) {
+  bufpool_set_limit(0);
+  struct bufpool_stats before;
+  bufpool_get_stats(&before);
+  void* a = bufpool_alloc(1 << 16);
+  ASSERT_TRUE(a != nullptr);
+  bufpool_free(a);
+  struct bufpool_stats after;
+  bufpool_get_stats(&after);
+  EXPECT_EQ(after.released - before.released, 1u);
+  EXPECT_EQ(after.cached_bytes, 0u);
+  bufpool_set_limit(BUFPOOL_DEFAULT_LIMIT);
+}
+
+struct parked_thread {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int cached;
+  int release;
+};
+
+// Garder un tampon dans le cache du thread, puis attendre sans se terminer
+static void* cache_and_wait_main(void* arg) {
+  struct parked_thread* t = static_cast<struct parked_thread*>(arg);
+  bufpool_free(bufpool_alloc(1 << 20));
+  pthread_mutex_lock(&t->lock);
+  t->cached = 1;
+  pthread_cond_broadcast(&t->cond);
+  while (!t->release) {
+    pthread_cond_wait(&t->cond, &t->lock);
+  }
+  pthread_mutex_unlock(&t->lock);
+  return NULL;
+}
+
+/*
+ * bufpool_trim() vide aussi le cache d'un thread vivant qui ne touche plus à
+ * la réserve, comme un travailleur au repos.
+ */
+TEST(BufPool, TrimAllThreads) {
+  bufpool_set_limit(BUFPOOL_DEFAULT_LIMIT);
+  struct parked_thread t = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                            0, 0};
+  pthread_t thread;
+  ASSERT_EQ(pthread_create(&thread, NULL, cache_and_wait_main, &t), 0);
+  pthread_mutex_lock(&t.lock);
+  while (!t.cached) {
+    pthread_cond_wait(&t.cond, &t.lock);
+  }
+  pthread_mutex_unlock(&t.lock);
+
+  struct bufpool_stats stats;
+  bufpool_get_stats(&stats);
+  EXPECT_GE(stats.cached_bytes, (size_t)1 << 20);
+  bufpool_trim();
+  bufpool_get_stats(&stats);
+  EXPECT_EQ(stats.cached_bytes, 0u);
+
+  pthread_mutex_lock(&t.lock);
+  t.release = 1;
+  pthread_cond_broadcast(&t.cond);
+  pthread_mutex_unlock(&t.lock);
+  pthread_join(thread, NULL);
+}
@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <memory>
+
+#include "config.h"
+#include "filter.h"
+#include "image.h"
+#include "threadpool.h"
+
+struct threadpool_deleter {
+  void operator()(struct pool* p) { threadpool_join(p); }
+};
+
+struct image_deleter {
+  void operator()(image_t* img) { image_destroy(img); }
+};
+
+typedef std::unique_ptr<image_t, image_deleter> image_ptr;
+
+static void expect_identical(image_t* serial, image_t* parallel) {
+  ASSERT_TRUE(serial != nullptr);
+  ASSERT_TRUE(parallel != nullptr);
+  ASSERT_EQ(serial->width, parallel->width);
+  ASSERT_EQ(serial->height, parallel->height);
+  EXPECT_EQ(memcmp(serial->pixels, parallel->pixels,
+                   serial->width * serial->height * sizeof(pixel_t)),
+            0);
+}
+
+static void check_all_filters(struct pool* pool, image_t* img) {
+  pixel_t add = {{10, 200, 30, 0}};
+
+  expect_identical(image_ptr(filter_scale_up(img, 3)).get(),
+                   image_ptr(filter_scale_up_mt(pool, img, 3)).get());
+  expect_identical(image_ptr(filter_scale_up2(img)).get(),
+                   image_ptr(filter_scale_up2_mt(pool, img)).get());
+  expect_identical(image_ptr(filter_sobel(img)).get(),
+                   image_ptr(filter_sobel_mt(pool, img)).get());
+  expect_identical(image_ptr(filter_to_hsv(img)).get(),
+                   image_ptr(filter_to_hsv_mt(pool, img)).get());
+  expect_identical(image_ptr(filter_to_rgb(img)).get(),
+                   image_ptr(filter_to_rgb_mt(pool, img)).get());
+  expect_identical(image_ptr(filter_add_pixel(img, &add)).get(),
+                   image_ptr(filter_add_pixel_mt(pool, img, &add)).get());
+  expect_identical(image_ptr(filter_desaturate(img)).get(),
+                   image_ptr(filter_desaturate_mt(pool, img)).get());
+  expect_identical(image_ptr(filter_edge_identity(img)).get(),
+                   image_ptr(filter_edge_identity_mt(pool, img)).get());
+  expect_identical(image_ptr(filter_edge_detect(img)).get(),
+                   image_ptr(filter_edge_detect_mt(pool, img)).get());
+  expect_identical(image_ptr(filter_sharpen(img)).get(),
+                   image_ptr(filter_sharpen_mt(pool, img)).get());
+  expect_identical(image_ptr(filter_box_blur(img)).get(),
+                   image_ptr(filter_box_blur_mt(pool, img)).get());
+  expect_identical(image_ptr(filter_gaussian_blur(img)).get(),
+                   image_ptr(filter_gaussian_blur_mt(pool, img)).get());
+  expect_identical(image_ptr(filter_horizontal_flip(img)).get(),
+                   image_ptr(filter_horizontal_flip_mt(pool, img)).get());
+  expect_identical(image_ptr(filter_vertical_flip(img)).get(),
+                   image_ptr(filter_vertical_flip_mt(pool, img)).get());
+}
+
+typedef image_t* (*into_fn)(image_t* dst, image_t* src);
+typedef image_t* (*into_mt_fn)(struct pool* pool, image_t* dst, image_t* src);
+
+// Filtre dans une image neuve puis dans une copie de la source elle-même
+static void check_into(struct pool* pool, image_t* img, image_t* expected,
+                       into_fn into, into_mt_fn into_mt) {
+  image_ptr dst(image_create(img->id, img->width, img->height));
+  EXPECT_EQ(into(dst.get(), img), dst.get());
+  expect_identical(expected, dst.get());
+
+  image_ptr dst_mt(image_create(img->id, img->width, img->height));
+  EXPECT_EQ(into_mt(pool, dst_mt.get(), img), dst_mt.get());
+  expect_identical(expected, dst_mt.get());
+
+  image_ptr copy(image_copy(img));
+  EXPECT_EQ(into(copy.get(), copy.get()), copy.get());
+  expect_identical(expected, copy.get());
+
+  image_ptr copy_mt(image_copy(img));
+  EXPECT_EQ(into_mt(pool, copy_mt.get(), copy_mt.get()), copy_mt.get());
+  expect_identical(expected, copy_mt.get());
+}
+
+static pixel_t add_into = {{10, 200, 30, 0}};
+
+static image_t* add_pixel_into(image_t* dst, image_t* src) {
+  return filter_add_pixel_into(dst, src, &add_into);
+}
+
+static image_t* add_pixel_into_mt(struct pool* pool, image_t* dst,
+                                  image_t* src) {
+  return filter_add_pixel_into_mt(pool, dst, src, &add_into);
+}
+
+static void check_all_into(struct pool* pool, image_t* img) {
+  check_into(pool, img, image_ptr(filter_to_hsv(img)).get(),
+             filter_to_hsv_into, filter_to_hsv_into_mt);
+  check_into(pool, img, image_ptr(filter_to_rgb(img)).get(),
+             filter_to_rgb_into, filter_to_rgb_into_mt);
+  check_into(pool, img, image_ptr(filter_add_pixel(img, &add_into)).get(),
+             add_pixel_into, add_pixel_into_mt);
+  check_into(pool, img, image_ptr(filter_desaturate(img)).get(),
+             filter_desaturate_into, filter_desaturate_into_mt);
+  check_into(pool, img, image_ptr(filter_horizontal_flip(img)).get(),
+             filter_horizontal_flip_into, filter_horizontal_flip_into_mt);
+  check_into(pool, img, image_ptr(filter_vertical_flip(img)).get(),
+             filter_vertical_flip_into, filter_vertical_flip_into_mt);
+}
+
+/*
+ * Chaque filtre découpé en bandes de lignes sur le pool produit exactement les
+ * mêmes octets que sa version séquentielle.
+ */
+TEST(Filter, RowBandsMatchSerial) {
+  std::unique_ptr<struct pool, threadpool_deleter> p(threadpool_create(4));
+  ASSERT_TRUE(p.get() != nullptr);
+
+  image_ptr img(image_create_from_png(SOURCE_DIR "/test/cat.png"));
+  ASSERT_TRUE(img.get() != nullptr);
+
+  check_all_filters(p.get(), img.get());
+}
+
+/*
+ * Les variantes _into et _inplace produisent les mêmes octets que le filtre
+ * qui alloue son image, séquentielles ou découpées sur le pool.
+ */
+TEST(Filter, IntoAndInPlace) {
+  std::unique_ptr<struct pool, threadpool_deleter> p(threadpool_create(4));
+  ASSERT_TRUE(p.get() != nullptr);
+
+  image_ptr img(image_create_from_png(SOURCE_DIR "/test/cat.png"));
+  ASSERT_TRUE(img.get() != nullptr);
+  check_all_into(p.get(), img.get());
+
+  // Hauteur impaire: la ligne du milieu reste en place
+  image_ptr odd(image_create(0, 5, 3));
+  ASSERT_TRUE(odd.get() != nullptr);
+  for (size_t i = 0; i < odd->width * odd->height; i++) {
+    for (int k = 0; k < 4; k++) {
+      odd->pixels[i].bytes[k] = (unsigned char)(i * 37 + k * 11);
+    }
+  }
+  check_all_into(p.get(), odd.get());
+
+  image_ptr inplace(image_copy(img.get()));
+  EXPECT_EQ(filter_desaturate_inplace(inplace.get()), inplace.get());
+  expect_identical(image_ptr(filter_desaturate(img.get())).get(),
+                   inplace.get());
+
+  // Destination d'une autre taille
+  image_ptr small(image_create(0, 2, 2));
+  EXPECT_TRUE(filter_desaturate_into(small.get(), img.get()) == nullptr);
+  EXPECT_TRUE(filter_vertical_flip_into_mt(p.get(), small.get(), img.get()) ==
+              nullptr);
+  EXPECT_TRUE(filter_to_hsv_into(NULL, img.get()) == nullptr);
+}
+
+/*
+ * Petites images: une seule ligne de sortie pour les filtres 3x3, moins de
+ * lignes que de travailleurs pour les autres.
+ */
+TEST(Filter, SmallImages) {
+  std::unique_ptr<struct pool, threadpool_deleter> p(threadpool_create(4));
+  ASSERT_TRUE(p.get() != nullptr);
+
+  image_ptr img(image_create(0, 7, 3));
+  ASSERT_TRUE(img.get() != nullptr);
+  for (size_t i = 0; i < img->width * img->height; i++) {
+    for (int k = 0; k < 4; k++) {
+      img->pixels[i].bytes[k] = (unsigned char)(i * 37 + k * 11);
+    }
+  }
+
+  check_all_filters(p.get(), img.get());
+}
+
+#include "processing.h"
+
+/*
+ * Le traitement d'une image dont les lignes sont découpées sur le pool produit
+ * le même fichier que le traitement d'une image par tâche. Avec la compression
+ * répartie sur le pool, seuls les pixels sont identiques.
+ */
+TEST(Filter, ProcessingSplitRows) {
+  const char* outputs[] = {BINARY_DIR "/test/cat-split-never.png",
+                           BINARY_DIR "/test/cat-split-always.png",
+                           BINARY_DIR "/test/cat-split-encode.png"};
+  const enum process_split splits[] = {
+      PROCESS_SPLIT_NEVER, PROCESS_SPLIT_ALWAYS, PROCESS_SPLIT_ALWAYS};
+  struct list* work_list = list_new(NULL, free_work_item);
+  struct work_item* item
+      = (struct work_item*)calloc(1, sizeof(struct work_item));
+
+  item->input_file = strdup(SOURCE_DIR "/test/cat.png");
+  list_push_back(work_list, list_node_new(item));
+
+  struct pool_attr attr;
+  threadpool_attr_init(&attr, 4);
+  attr.work_stealing = 1;
+  std::unique_ptr<struct pool, threadpool_deleter> p(
+      threadpool_create_attr(&attr));
+  ASSERT_TRUE(p.get() != nullptr);
+
+  for (int i = 0; i < 3; i++) {
+    struct process_opts opts;
+    process_opts_init(&opts);
+    opts.split = splits[i];
+    opts.parallel_encode = i == 2;
+    free(item->output_file);
+    item->output_file = strdup(outputs[i]);
+    EXPECT_EQ(process_on_pool_opts(work_list, p.get(), &opts), 0);
+  }
+
+  list_free(work_list);
+  expect_identical(image_ptr(image_create_from_png(outputs[0])).get(),
+                   image_ptr(image_create_from_png(outputs[1])).get());
+  expect_identical(image_ptr(image_create_from_png(outputs[0])).get(),
+                   image_ptr(image_create_from_png(outputs[2])).get());
+}
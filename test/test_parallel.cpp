@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "parallel.h"
+#include "threadpool.h"
+
+struct threadpool_deleter {
+  void operator()(struct pool* p) { threadpool_join(p); }
+};
+
+static void double_range(void* ctx, size_t begin, size_t end) {
+  std::vector<int>& v = *static_cast<std::vector<int>*>(ctx);
+  for (size_t i = begin; i < end; i++) {
+    v[i] += 2 * i;
+  }
+}
+
+static void sum_range(void*, size_t begin, size_t end, void* acc) {
+  for (size_t i = begin; i < end; i++) {
+    *static_cast<uint64_t*>(acc) += i;
+  }
+}
+
+static void sum_combine(void*, void* acc, const void* partial) {
+  *static_cast<uint64_t*>(acc) += *static_cast<const uint64_t*>(partial);
+}
+
+/*
+ * Chaque indice de l'intervalle est visité exactement une fois, avec un grain
+ * fixe ou automatique, y compris pour les intervalles vides ou plus petits
+ * qu'une tranche.
+ */
+TEST(Parallel, ForVisitsEachIndexOnce) {
+  std::unique_ptr<struct pool, threadpool_deleter> p(threadpool_create(4));
+  ASSERT_TRUE(p.get() != nullptr);
+
+  const size_t sizes[] = {0, 1, 7, 1000, 1000000};
+  const size_t grains[] = {0, 1, 64, 5000};
+  for (size_t n : sizes) {
+    for (size_t grain : grains) {
+      std::vector<int> v(n + 10, 0);
+      threadpool_parallel_for(p.get(), 5, n + 5, grain, double_range, &v);
+      for (size_t i = 0; i < v.size(); i++) {
+        int expected = (i >= 5 && i < n + 5) ? 2 * i : 0;
+        ASSERT_EQ(v[i], expected) << "n=" << n << " grain=" << grain;
+      }
+    }
+  }
+}
+
+TEST(Parallel, Reduce) {
+  std::unique_ptr<struct pool, threadpool_deleter> p(threadpool_create(4));
+  ASSERT_TRUE(p.get() != nullptr);
+
+  const uint64_t zero = 0;
+  const size_t sizes[] = {0, 1, 1000, 3000000};
+  for (size_t n : sizes) {
+    for (size_t grain : {0, 100}) {
+      uint64_t sum = 42;
+      threadpool_parallel_reduce(p.get(), 0, n, grain, sizeof(uint64_t), &zero,
+                                 sum_range, sum_combine, NULL, &sum);
+      EXPECT_EQ(sum, n ? (uint64_t)n * (n - 1) / 2 : 0) << "n=" << n;
+    }
+  }
+}
+
+struct nested_arg {
+  struct pool* pool;
+  std::vector<int>* v;
+};
+
+static void* nested_task(void* arg) {
+  struct nested_arg* a = static_cast<struct nested_arg*>(arg);
+  threadpool_parallel_for(a->pool, 0, a->v->size(), 16, double_range, a->v);
+  return NULL;
+}
+
+/*
+ * Des boucles parallèles lancées depuis toutes les tâches du pool en même
+ * temps ne doivent pas s'interbloquer: l'appelant exécute lui-même les
+ * tranches si aucun travailleur n'est libre.
+ */
+TEST(Parallel, NestedInPoolTasks) {
+  const int n_threads = 2;
+  const int n_tasks = 8;
+
+  for (int stealing = 0; stealing <= 1; stealing++) {
+    struct pool_attr attr;
+    threadpool_attr_init(&attr, n_threads);
+    attr.work_stealing = stealing;
+    std::unique_ptr<struct pool, threadpool_deleter> p(
+        threadpool_create_attr(&attr));
+    ASSERT_TRUE(p.get() != nullptr);
+
+    std::vector<std::vector<int>> vs(n_tasks, std::vector<int>(4096, 0));
+    std::vector<struct nested_arg> args(n_tasks);
+    for (int i = 0; i < n_tasks; i++) {
+      args[i] = {p.get(), &vs[i]};
+      threadpool_add_task(p.get(), nested_task, &args[i]);
+    }
+    threadpool_wait(p.get());
+
+    for (auto& v : vs) {
+      for (size_t i = 0; i < v.size(); i++) {
+        ASSERT_EQ(v[i], 2 * i);
+      }
+    }
+  }
+}
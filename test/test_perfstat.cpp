@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+
+#include "image.h"
+#include "perfstat.h"
+#include "processing.h"
+
+/*
+ * Chaque filtre de process_apply_filters() est une étape, après le décodage.
+ * Le temps est toujours mesuré; un compteur refusé par le noyau reste à zéro.
+ */
+TEST(Perfstat, FilterStages) {
+  int nb_counters = perfstat_start();
+  EXPECT_GE(nb_counters, 0);
+  EXPECT_LE(nb_counters, PERFSTAT_NB_COUNTERS);
+
+  image_t* img = image_create(0, 64, 32);
+  ASSERT_TRUE(img != nullptr);
+  img = process_apply_filters(img, NULL);
+  ASSERT_TRUE(img != nullptr);
+  image_destroy(img);
+
+  struct perfstat_stage stage;
+  EXPECT_EQ(perfstat_get(0, &stage), -1);  // pas de décodage
+  ASSERT_EQ(perfstat_get(1, &stage), 0);
+  EXPECT_STREQ(stage.name, "scale_up2");
+  EXPECT_EQ(stage.nb_calls, 1u);
+  EXPECT_EQ(stage.pixels, 128u * 64);
+  EXPECT_GT(stage.ns, 0u);
+  int nb_filters = 0;
+  for (int i = 1; perfstat_get(i, &stage) == 0; i++) {
+    nb_filters++;
+    for (int c = 0; c < PERFSTAT_NB_COUNTERS; c++) {
+      if (!perfstat_available((enum perfstat_counter)c)) {
+        EXPECT_EQ(stage.values[c], 0u);
+      }
+    }
+  }
+  EXPECT_EQ(nb_filters, 4);
+
+  // Rien n'est compté après l'arrêt
+  perfstat_stop();
+  img = process_apply_filters(image_create(0, 8, 8), NULL);
+  image_destroy(img);
+  ASSERT_EQ(perfstat_get(1, &stage), 0);
+  EXPECT_EQ(stage.nb_calls, 1u);
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "config.h"
+#include "pipeline.h"
+#include "processing.h"
+
+static bool are_files_identical(const std::string& file1_path,
+                                const std::string& file2_path) {
+  std::ifstream file1(file1_path, std::ifstream::binary);
+  std::ifstream file2(file2_path, std::ifstream::binary);
+
+  if (!file1.is_open() || !file2.is_open()) {
+    return false;
+  }
+
+  std::istreambuf_iterator<char> file1_iter(file1), file1_end;
+  std::istreambuf_iterator<char> file2_iter(file2), file2_end;
+
+  return std::equal(file1_iter, file1_end, file2_iter, file2_end);
+}
+
+static struct work_item* add_item(struct list* work_list, const char* input,
+                                  const std::string& output) {
+  struct work_item* item
+      = (struct work_item*)calloc(1, sizeof(struct work_item));
+  item->input_file = strdup(input);
+  item->output_file = strdup(output.c_str());
+  list_push_back(work_list, list_node_new(item));
+  return item;
+}
+
+/*
+ * Le pipeline produit les mêmes fichiers que le traitement séquentiel, et avec
+ * des files de capacité 1 et un thread par étage, au plus 5 images sont en
+ * mémoire au même moment.
+ */
+TEST(Pipeline, MatchesSerial) {
+  const std::string prefix = BINARY_DIR "/test/cat-pipeline-";
+  const char* img = SOURCE_DIR "/test/cat.png";
+  const int nb_images = 3;
+
+  struct list* serial = list_new(NULL, free_work_item);
+  add_item(serial, img, prefix + "serial.png");
+  EXPECT_EQ(process_serial(serial), 0);
+  list_free(serial);
+
+  struct list* work_list = list_new(NULL, free_work_item);
+  for (int i = 0; i < nb_images; i++) {
+    add_item(work_list, img, prefix + std::to_string(i) + ".png");
+  }
+
+  struct pipeline_attr attr;
+  pipeline_attr_init(&attr, 3);
+  attr.queue_capacity = 1;
+  struct pipeline_stats stats;
+  EXPECT_EQ(process_pipeline(work_list, &attr, &stats), 0);
+  list_free(work_list);
+
+  for (int s = 0; s < PIPELINE_NB_STAGES; s++) {
+    EXPECT_EQ(stats.nb_threads[s], 1);
+    EXPECT_EQ(stats.nb_images[s], (size_t)nb_images);
+    EXPECT_GT(stats.busy_ns[s], 0u);
+    EXPECT_LE(stats.busy_ns[s], stats.wall_ns);
+  }
+  EXPECT_GE(stats.max_in_flight, 1u);
+  EXPECT_LE(stats.max_in_flight, 5u);
+
+  for (int i = 0; i < nb_images; i++) {
+    EXPECT_TRUE(are_files_identical(prefix + "serial.png",
+                                    prefix + std::to_string(i) + ".png"));
+  }
+}
+
+/*
+ * Une image illisible est comptée comme un échec sans bloquer les étages
+ * suivants.
+ */
+TEST(Pipeline, DecodeFailure) {
+  struct list* work_list = list_new(NULL, free_work_item);
+  add_item(work_list, SOURCE_DIR "/test/missing.png",
+           BINARY_DIR "/test/missing-pipeline.png");
+
+  struct pipeline_attr attr;
+  pipeline_attr_init(&attr, 6);
+  struct pipeline_stats stats;
+  EXPECT_EQ(process_pipeline(work_list, &attr, &stats), -1);
+  EXPECT_EQ(stats.nb_images[PIPELINE_DECODE], 0u);
+  EXPECT_EQ(stats.nb_images[PIPELINE_ENCODE], 0u);
+  EXPECT_EQ(stats.max_in_flight, 0u);
+  list_free(work_list);
+}
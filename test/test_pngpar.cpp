@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <png.h>
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "image.h"
+#include "pngpar.h"
+#include "threadpool.h"
+
+// Image de plusieurs tranches: des dégradés, du bruit et des aplats
+static image_t* make_image(size_t width, size_t height) {
+  image_t* img = image_create(0, width, height);
+  unsigned int seed = 42;
+  for (size_t j = 0; j < height; j++) {
+    for (size_t i = 0; i < width; i++) {
+      pixel_t* pixel = image_get_pixel(img, i, j);
+      int flat = (j / 64) % 3 == 0;
+      pixel->bytes[0] = flat ? 10 : i + j;
+      pixel->bytes[1] = flat ? 20 : i * 3 + (rand_r(&seed) & 7);
+      pixel->bytes[2] = flat ? 30 : j ^ i;
+      pixel->bytes[3] = 255 - (i & 1);
+    }
+  }
+  return img;
+}
+
+static uint32_t get_u32(const unsigned char* p) {
+  return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+// Concaténation des IDAT du fichier, après vérification de chaque CRC
+static std::vector<unsigned char> read_idat(const char* fname) {
+  std::vector<unsigned char> idat;
+  FILE* f = fopen(fname, "rb");
+  EXPECT_TRUE(f != nullptr);
+  if (!f) {
+    return idat;
+  }
+  std::vector<unsigned char> file;
+  unsigned char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    file.insert(file.end(), buf, buf + n);
+  }
+  fclose(f);
+
+  size_t pos = 8;
+  while (pos + 12 <= file.size()) {
+    uint32_t len = get_u32(&file[pos]);
+    const unsigned char* type = &file[pos + 4];
+    const unsigned char* data = type + 4;
+    uLong crc = crc32(crc32(0, type, 4), data, len);
+    EXPECT_EQ(crc, get_u32(data + len));
+    if (memcmp(type, "IDAT", 4) == 0) {
+      idat.insert(idat.end(), data, data + len);
+    }
+    pos += 12 + len;
+  }
+  EXPECT_EQ(pos, file.size());
+  return idat;
+}
+
+static void check_round_trip(struct pool* pool, image_t* img,
+                             const image_png_opts_t* opts) {
+  std::string fname = BINARY_DIR "/test/pngpar.png";
+  ASSERT_EQ(pngpar_save(pool, img, fname.c_str(), opts), 0);
+
+  // Un seul flux zlib: uncompress vérifie aussi l'Adler-32 combiné
+  std::vector<unsigned char> idat = read_idat(fname.c_str());
+  uLongf raw_len = img->height * (1 + img->width * sizeof(pixel_t));
+  std::vector<unsigned char> raw(raw_len);
+  uLongf out_len = raw_len;
+  EXPECT_EQ(uncompress(raw.data(), &out_len, idat.data(), idat.size()), Z_OK);
+  EXPECT_EQ(out_len, raw_len);
+
+  image_t* back = image_create_from_png(fname.c_str());
+  ASSERT_TRUE(back != nullptr);
+  ASSERT_EQ(back->width, img->width);
+  ASSERT_EQ(back->height, img->height);
+  EXPECT_EQ(memcmp(back->pixels, img->pixels,
+                   img->width * img->height * sizeof(pixel_t)),
+            0);
+  image_destroy(back);
+  remove(fname.c_str());
+}
+
+/*
+ * Les fichiers écrits par tranches sur le pool se relisent avec libpng et
+ * zlib, pour chaque filtre de ligne et quelques niveaux et stratégies.
+ */
+TEST(PngPar, RoundTrip) {
+  struct pool* pool = threadpool_create(4);
+  ASSERT_TRUE(pool != nullptr);
+
+  // Lignes de 2801 octets: 374 lignes par tranche, dernière tranche partielle
+  image_t* img = make_image(700, 800);
+  ASSERT_TRUE(img != nullptr);
+
+  const int filters[] = {-1,
+                         PNG_FILTER_NONE,
+                         PNG_FILTER_SUB,
+                         PNG_FILTER_UP,
+                         PNG_FILTER_AVG,
+                         PNG_FILTER_PAETH,
+                         PNG_FILTER_SUB | PNG_FILTER_PAETH};
+  for (int filter : filters) {
+    image_png_opts_t opts;
+    image_png_opts_init(&opts);
+    opts.filters = filter;
+    SCOPED_TRACE(filter);
+    check_round_trip(pool, img, &opts);
+  }
+
+  image_png_opts_t opts;
+  image_png_opts_init(&opts);
+  opts.level = 1;
+  opts.strategy = Z_RLE;
+  check_round_trip(pool, img, &opts);
+  opts.level = 0;
+  check_round_trip(pool, img, &opts);
+  opts.level = 9;
+  opts.strategy = Z_DEFAULT_STRATEGY;
+  check_round_trip(pool, img, &opts);
+
+  // Lignes plus longues qu'une tranche: une ligne par tranche
+  image_t* wide = make_image(270000, 3);
+  ASSERT_TRUE(wide != nullptr);
+  image_png_opts_init(&opts);
+  check_round_trip(pool, wide, &opts);
+  // Sans pool, écrite par libpng
+  check_round_trip(NULL, wide, &opts);
+
+  image_destroy(wide);
+  image_destroy(img);
+  threadpool_join(pool);
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "taskgraph.h"
+#include "threadpool.h"
+
+struct step {
+  int* clock;  // horloge logique partagée
+  int stamp;   // valeur de l'horloge à l'exécution
+  int worker;  // travailleur qui a exécuté le noeud
+  struct pool* pool;
+};
+
+static void* step_task(void* arg) {
+  struct step* s = static_cast<struct step*>(arg);
+  s->stamp = __atomic_add_fetch(s->clock, 1, __ATOMIC_SEQ_CST);
+  s->worker = threadpool_worker_id(s->pool);
+  return s;
+}
+
+/*
+ * Losange A -> {B, C} -> D, répété en largeur: D ne démarre qu'après B et C,
+ * qui démarrent après A. Le graphe peut être exécuté deux fois.
+ */
+TEST(TaskGraph, Dependencies) {
+  const int width = 16;
+  struct pool* pool = threadpool_create(4);
+  ASSERT_TRUE(pool != nullptr);
+  struct taskgraph* g = taskgraph_new(pool);
+  ASSERT_TRUE(g != nullptr);
+
+  int clock = 0;
+  std::vector<struct step> a(width), b(width), c(width), d(width);
+  std::vector<struct taskgraph_node*> nodes;
+  for (int i = 0; i < width; i++) {
+    for (auto* s : {&a[i], &b[i], &c[i], &d[i]}) {
+      *s = {&clock, 0, -1, pool};
+    }
+    struct taskgraph_node* na = taskgraph_add(g, step_task, &a[i]);
+    struct taskgraph_node* nb = taskgraph_add(g, step_task, &b[i]);
+    struct taskgraph_node* nc = taskgraph_add(g, step_task, &c[i]);
+    struct taskgraph_node* nd = taskgraph_add(g, step_task, &d[i]);
+    ASSERT_EQ(taskgraph_edge(g, na, nb), 0);
+    ASSERT_EQ(taskgraph_edge(g, na, nc), 0);
+    ASSERT_EQ(taskgraph_edge(g, nb, nd), 0);
+    ASSERT_EQ(taskgraph_edge(g, nc, nd), 0);
+    nodes.push_back(nd);
+  }
+  EXPECT_EQ(taskgraph_size(g), (size_t)(4 * width));
+
+  for (int run = 1; run <= 2; run++) {
+    ASSERT_EQ(taskgraph_run(g), 0);
+    EXPECT_EQ(clock, run * 4 * width);
+    for (int i = 0; i < width; i++) {
+      EXPECT_LT(a[i].stamp, b[i].stamp);
+      EXPECT_LT(a[i].stamp, c[i].stamp);
+      EXPECT_LT(b[i].stamp, d[i].stamp);
+      EXPECT_LT(c[i].stamp, d[i].stamp);
+      EXPECT_EQ(taskgraph_result(nodes[i]), &d[i]);
+    }
+  }
+
+  taskgraph_free(g);
+  threadpool_join(pool);
+}
+
+/*
+ * Une chaîne s'exécute en continuation: chaque noeud devenu prêt est exécuté
+ * par le travailleur qui a terminé son prédécesseur.
+ */
+TEST(TaskGraph, ContinuationSameWorker) {
+  const int length = 64;
+  struct pool* pool = threadpool_create(4);
+  ASSERT_TRUE(pool != nullptr);
+  struct taskgraph* g = taskgraph_new(pool);
+
+  int clock = 0;
+  std::vector<struct step> steps(length, {&clock, 0, -1, pool});
+  struct taskgraph_node* prev = nullptr;
+  for (int i = 0; i < length; i++) {
+    struct taskgraph_node* node = taskgraph_add(g, step_task, &steps[i]);
+    if (prev) {
+      ASSERT_EQ(taskgraph_edge(g, prev, node), 0);
+    }
+    prev = node;
+  }
+  ASSERT_EQ(taskgraph_run(g), 0);
+
+  for (int i = 0; i < length; i++) {
+    EXPECT_EQ(steps[i].stamp, i + 1);
+    EXPECT_EQ(steps[i].worker, steps[0].worker);
+  }
+  EXPECT_GE(steps[0].worker, 0);
+
+  taskgraph_free(g);
+  threadpool_join(pool);
+}
+
+/*
+ * Un graphe avec un cycle est refusé sans rien exécuter; un graphe vide se
+ * termine aussitôt. Les arêtes entre deux graphes sont refusées.
+ */
+TEST(TaskGraph, CycleAndEmpty) {
+  struct pool* pool = threadpool_create(2);
+  ASSERT_TRUE(pool != nullptr);
+
+  struct taskgraph* empty = taskgraph_new(pool);
+  EXPECT_EQ(taskgraph_run(empty), 0);
+
+  int clock = 0;
+  struct step s[3] = {{&clock, 0, -1, pool},
+                      {&clock, 0, -1, pool},
+                      {&clock, 0, -1, pool}};
+  struct taskgraph* g = taskgraph_new(pool);
+  struct taskgraph_node* n0 = taskgraph_add(g, step_task, &s[0]);
+  struct taskgraph_node* n1 = taskgraph_add(g, step_task, &s[1]);
+  struct taskgraph_node* n2 = taskgraph_add(g, step_task, &s[2]);
+  ASSERT_EQ(taskgraph_edge(g, n0, n1), 0);
+  ASSERT_EQ(taskgraph_edge(g, n1, n2), 0);
+  ASSERT_EQ(taskgraph_edge(g, n2, n1), 0);
+  EXPECT_EQ(taskgraph_run(g), -1);
+  threadpool_wait(pool);
+  EXPECT_EQ(clock, 0);
+
+  struct taskgraph_node* other = taskgraph_add(empty, step_task, &s[0]);
+  EXPECT_EQ(taskgraph_edge(g, n0, other), -1);
+
+  taskgraph_free(g);
+  taskgraph_free(empty);
+  threadpool_join(pool);
+}
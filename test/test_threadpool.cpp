@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
+#include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <time.h>
 #include <unistd.h>
@@ -8,9 +10,12 @@
 #include <istream>
 #include <iterator>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "barrier.h"
+#include "bufpool.h"
 #include "config.h"
 #include "threadpool.h"
 
@@ -103,6 +108,699 @@ TEST(ThreadPool, Usage) {
   }
 }
 
+/*
+ * Chaque tâche soumet ses deux enfants depuis le pool: en mode vol de tâches,
+ * elles passent par la deque locale et sont volées par les autres travailleurs.
+ * threadpool_join() doit attendre tout l'arbre, y compris les sous-tâches
+ * soumises après son appel.
+ */
+struct tree_arg {
+  struct pool* pool;
+  int depth;
+  int* count;
+};
+
+static void* tree_task(void* arg) {
+  struct tree_arg* t = static_cast<struct tree_arg*>(arg);
+  __atomic_add_fetch(t->count, 1, __ATOMIC_RELAXED);
+  if (t->depth > 0) {
+    for (int i = 0; i < 2; i++) {
+      struct tree_arg* child = new tree_arg{t->pool, t->depth - 1, t->count};
+      threadpool_add_task(t->pool, tree_task, child);
+    }
+  }
+  delete t;
+  return NULL;
+}
+
+TEST(ThreadPool, WorkStealingNested) {
+  int depth = 12;
+  int count = 0;
+
+  struct pool_attr attr;
+  threadpool_attr_init(&attr, 4);
+  attr.work_stealing = 1;
+  struct pool* p = threadpool_create_attr(&attr);
+  ASSERT_TRUE(p != nullptr);
+
+  threadpool_add_task(p, tree_task, new tree_arg{p, depth, &count});
+  threadpool_join(p);
+
+  EXPECT_EQ(count, (1 << (depth + 1)) - 1);
+}
+
+/*
+ * Anneau volontairement petit: le producteur externe doit attendre qu'une place
+ * se libère et les sous-tâches soumises par les travailleurs sont exécutées
+ * sur place lorsque l'anneau est plein.
+ */
+TEST(ThreadPool, RingQueue) {
+  for (int stealing = 0; stealing <= 1; stealing++) {
+    int depth = 10;
+    int count = 0;
+
+    struct pool_attr attr;
+    threadpool_attr_init(&attr, 4);
+    attr.work_stealing = stealing;
+    attr.queue = THREADPOOL_QUEUE_RING;
+    attr.ring_capacity = 8;
+    struct pool* p = threadpool_create_attr(&attr);
+    ASSERT_TRUE(p != nullptr);
+
+    for (int i = 0; i < 16; i++) {
+      threadpool_add_task(p, tree_task, new tree_arg{p, depth, &count});
+    }
+    threadpool_join(p);
+
+    EXPECT_EQ(count, 16 * ((1 << (depth + 1)) - 1)) << "stealing=" << stealing;
+  }
+}
+
+static void* count_task(void* arg) {
+  __atomic_add_fetch(static_cast<int*>(arg), 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+/*
+ * Les tâches exécutées sont recyclées: après de nombreuses vagues de soumission,
+ * le nombre de blocs alloués reste borné par le nombre de tâches en vol plus
+ * les caches des travailleurs, peu importe le nombre total de tâches.
+ */
+TEST(ThreadPool, TaskRecycling) {
+  int n_threads = 4;
+  int n_tasks = 1000;
+  int n_rounds = 20;
+  int count = 0;
+
+  std::unique_ptr<struct pool, threadpool_deleter> p(
+      threadpool_create(n_threads));
+  ASSERT_TRUE(p.get() != nullptr);
+
+  for (int i = 0; i < n_rounds; i++) {
+    for (int j = 0; j < n_tasks; j++) {
+      threadpool_add_task(p.get(), count_task, &count);
+    }
+    threadpool_wait(p.get());
+    ASSERT_EQ(count, n_tasks * (i + 1));
+  }
+
+  size_t bound = n_tasks + n_threads * THREADPOOL_TASK_CACHE;
+  EXPECT_GE(threadpool_task_allocs(p.get()), 1);
+  EXPECT_LE(threadpool_task_allocs(p.get()),
+            bound / THREADPOOL_TASK_SLAB + 1);
+}
+
+static void* mark_task(void* arg) {
+  __atomic_add_fetch(static_cast<int*>(arg), 1, __ATOMIC_RELAXED);
+  return NULL;
+}
+
+/*
+ * Soumission par lot: chaque argument doit être exécuté exactement une fois,
+ * y compris lorsque l'anneau est trop petit pour réserver le lot d'un coup.
+ */
+TEST(ThreadPool, BatchSubmit) {
+  const size_t n_tasks = 5000;
+  const enum threadpool_queue queues[] = {THREADPOOL_QUEUE_LIST,
+                                          THREADPOOL_QUEUE_RING};
+
+  for (auto queue : queues) {
+    for (int stealing = 0; stealing <= 1; stealing++) {
+      std::vector<int> marks(n_tasks, 0);
+      std::vector<void*> args(n_tasks);
+      for (size_t i = 0; i < n_tasks; i++) {
+        args[i] = &marks[i];
+      }
+
+      struct pool_attr attr;
+      threadpool_attr_init(&attr, 4);
+      attr.work_stealing = stealing;
+      attr.queue = queue;
+      attr.ring_capacity = 64;
+      struct pool* p = threadpool_create_attr(&attr);
+      ASSERT_TRUE(p != nullptr);
+
+      threadpool_add_tasks(p, mark_task, args.data(), n_tasks / 2);
+      threadpool_add_tasks(p, mark_task, args.data() + n_tasks / 2,
+                           n_tasks - n_tasks / 2);
+      threadpool_join(p);
+
+      for (size_t i = 0; i < n_tasks; i++) {
+        ASSERT_EQ(marks[i], 1) << "task " << i << " queue=" << queue
+                               << " stealing=" << stealing;
+      }
+    }
+  }
+}
+
+/*
+ * threadpool_wait() attend la fin du lot courant sans détruire le pool: les
+ * mêmes travailleurs servent les lots suivants.
+ */
+TEST(ThreadPool, WaitAndReuse) {
+  int n_threads = 4;
+  int n_tasks = 200;
+  struct tidarg info;
+  pthread_mutex_init(&info.lock, NULL);
+  info.count = 0;
+
+  std::unique_ptr<struct pool, threadpool_deleter> p(
+      threadpool_create(n_threads));
+  ASSERT_TRUE(p.get() != nullptr);
+
+  for (int i = 0; i < 5; i++) {
+    for (int j = 0; j < n_tasks; j++) {
+      threadpool_add_task(p.get(), [](void* arg) -> void* {
+        struct tidarg* info = static_cast<struct tidarg*>(arg);
+        pthread_mutex_lock(&info->lock);
+        info->tidmap[gettid()]++;
+        info->count++;
+        pthread_mutex_unlock(&info->lock);
+        return NULL;
+      }, &info);
+    }
+    threadpool_wait(p.get());
+    EXPECT_EQ(info.count, n_tasks * (i + 1));
+  }
+  EXPECT_LE(info.tidmap.size(), n_threads);
+}
+
+static void* square_task(void* arg) {
+  intptr_t x = reinterpret_cast<intptr_t>(arg);
+  return reinterpret_cast<void*>(x * x);
+}
+
+TEST(ThreadPool, Futures) {
+  const int n_tasks = 100;
+  std::vector<struct future> futures(n_tasks);
+
+  std::unique_ptr<struct pool, threadpool_deleter> p(threadpool_create(4));
+  ASSERT_TRUE(p.get() != nullptr);
+
+  for (intptr_t i = 0; i < n_tasks; i++) {
+    threadpool_submit(p.get(), &futures[i], square_task,
+                      reinterpret_cast<void*>(i));
+  }
+  for (intptr_t i = n_tasks - 1; i >= 0; i--) {
+    EXPECT_EQ(reinterpret_cast<intptr_t>(future_get(&futures[i])), i * i);
+    EXPECT_TRUE(future_done(&futures[i]));
+  }
+}
+
+struct prio_log {
+  pthread_mutex_t lock;
+  std::vector<int> order;
+  int gate;
+};
+
+struct prio_arg {
+  struct prio_log* log;
+  int prio;
+};
+
+// Bloque le travailleur jusqu'à ce que toutes les tâches soient en file
+static void* gate_task(void* arg) {
+  struct prio_log* log = static_cast<struct prio_log*>(arg);
+  while (!__atomic_load_n(&log->gate, __ATOMIC_ACQUIRE)) {
+    sched_yield();
+  }
+  return NULL;
+}
+
+static void* prio_task(void* arg) {
+  struct prio_arg* a = static_cast<struct prio_arg*>(arg);
+  pthread_mutex_lock(&a->log->lock);
+  a->log->order.push_back(a->prio);
+  pthread_mutex_unlock(&a->log->lock);
+  return NULL;
+}
+
+// Soumettre les tâches dans l'ordre de counts (basse priorité d'abord) à un
+// pool d'un seul travailleur et retourner l'ordre d'exécution des priorités
+static std::vector<int> run_prio(enum threadpool_queue queue, int stealing,
+                                 unsigned int aging, const int counts[]) {
+  struct prio_log log;
+  pthread_mutex_init(&log.lock, NULL);
+  log.gate = 0;
+
+  struct pool_attr attr;
+  threadpool_attr_init(&attr, 1);
+  attr.queue = queue;
+  attr.work_stealing = stealing;
+  attr.aging = aging;
+  struct pool* pool = threadpool_create_attr(&attr);
+  threadpool_add_task(pool, gate_task, &log);
+
+  std::vector<struct prio_arg> args;
+  for (int p = THREADPOOL_NB_PRIO - 1; p >= 0; p--) {
+    for (int i = 0; i < counts[p]; i++) {
+      args.push_back({&log, p});
+    }
+  }
+  for (auto& a : args) {
+    threadpool_add_task_prio(pool, (enum threadpool_priority)a.prio, prio_task,
+                             &a);
+  }
+  __atomic_store_n(&log.gate, 1, __ATOMIC_RELEASE);
+  threadpool_join(pool);
+
+  pthread_mutex_destroy(&log.lock);
+  return log.order;
+}
+
+/*
+ * Sans vieillissement, les tâches les plus prioritaires passent d'abord, même
+ * soumises après un lot de tâches de basse priorité.
+ */
+TEST(ThreadPool, PriorityLanes) {
+  const int counts[] = {3, 4, 5};
+  std::vector<int> expected;
+  for (int p = 0; p < THREADPOOL_NB_PRIO; p++) {
+    expected.insert(expected.end(), counts[p], p);
+  }
+
+  for (auto queue : {THREADPOOL_QUEUE_LIST, THREADPOOL_QUEUE_RING}) {
+    for (int stealing = 0; stealing <= 1; stealing++) {
+      EXPECT_EQ(run_prio(queue, stealing, 0, counts), expected);
+    }
+  }
+}
+
+/*
+ * Avec aging = 2, une file basse priorité qui attend est servie après au plus
+ * deux tâches urgentes.
+ */
+TEST(ThreadPool, PriorityAging) {
+  const int counts[] = {6, 0, 3};
+  const int H = THREADPOOL_PRIO_HIGH;
+  const int L = THREADPOOL_PRIO_LOW;
+  const std::vector<int> expected = {H, H, L, H, H, L, H, H, L};
+
+  for (auto queue : {THREADPOOL_QUEUE_LIST, THREADPOOL_QUEUE_RING}) {
+    EXPECT_EQ(run_prio(queue, 0, 2, counts), expected);
+  }
+}
+
+struct relay_gate {
+  int started;
+  int open;
+};
+
+// Signale son démarrage, puis bloque le travailleur jusqu'à l'ouverture
+static void* relay_task(void* arg) {
+  struct relay_gate* g = static_cast<struct relay_gate*>(arg);
+  __atomic_store_n(&g->started, 1, __ATOMIC_RELEASE);
+  while (!__atomic_load_n(&g->open, __ATOMIC_ACQUIRE)) {
+    sched_yield();
+  }
+  return NULL;
+}
+
+/*
+ * En mode vol de tâches, les tâches de basse priorité ne sont pas transférées
+ * par lot dans la deque locale: des tâches normales soumises pendant qu'une
+ * tâche de fond s'exécute passent avant les tâches de fond restantes.
+ */
+TEST(ThreadPool, PriorityLowNotBatched) {
+  const int N = THREADPOOL_PRIO_NORMAL;
+  const int L = THREADPOOL_PRIO_LOW;
+  const std::vector<int> expected = {N, N, N, L, L, L, L};
+
+  for (auto queue : {THREADPOOL_QUEUE_LIST, THREADPOOL_QUEUE_RING}) {
+    struct prio_log log;
+    pthread_mutex_init(&log.lock, NULL);
+    log.gate = 0;
+    struct relay_gate relay = {0, 0};
+
+    struct pool_attr attr;
+    threadpool_attr_init(&attr, 1);
+    attr.queue = queue;
+    attr.work_stealing = 1;
+    attr.aging = 0;
+    struct pool* pool = threadpool_create_attr(&attr);
+    ASSERT_TRUE(pool != nullptr);
+    threadpool_add_task(pool, gate_task, &log);
+
+    std::vector<struct prio_arg> args(7, {&log, L});
+    threadpool_add_task_prio(pool, THREADPOOL_PRIO_LOW, relay_task, &relay);
+    for (int i = 0; i < 4; i++) {
+      threadpool_add_task_prio(pool, THREADPOOL_PRIO_LOW, prio_task, &args[i]);
+    }
+    __atomic_store_n(&log.gate, 1, __ATOMIC_RELEASE);
+
+    // Le travailleur exécute la première tâche de fond
+    while (!__atomic_load_n(&relay.started, __ATOMIC_ACQUIRE)) {
+      sched_yield();
+    }
+    for (int i = 4; i < 7; i++) {
+      args[i].prio = N;
+      threadpool_add_task(pool, prio_task, &args[i]);
+    }
+    __atomic_store_n(&relay.open, 1, __ATOMIC_RELEASE);
+    threadpool_join(pool);
+
+    EXPECT_EQ(log.order, expected) << "queue=" << queue;
+    pthread_mutex_destroy(&log.lock);
+  }
+}
+
+/*
+ * Attente active puis futex: aucune tâche ne doit être perdue, que les
+ * travailleurs soient en train d'attendre activement (spin) ou endormis entre
+ * deux lots (spin = 0), et threadpool_join() doit réveiller les endormis.
+ */
+TEST(ThreadPool, IdleSpin) {
+  const int n_tasks = 1000;
+  const int depth = 8;
+
+  for (auto queue : {THREADPOOL_QUEUE_LIST, THREADPOOL_QUEUE_RING}) {
+    for (int stealing = 0; stealing <= 1; stealing++) {
+      for (unsigned int spin : {0u, (unsigned int)THREADPOOL_SPIN}) {
+        struct pool_attr attr;
+        threadpool_attr_init(&attr, 4);
+        attr.work_stealing = stealing;
+        attr.queue = queue;
+        attr.idle = THREADPOOL_IDLE_SPIN;
+        attr.spin = spin;
+        struct pool* p = threadpool_create_attr(&attr);
+        ASSERT_TRUE(p != nullptr);
+
+        int count = 0;
+        for (int round = 1; round <= 3; round++) {
+          for (int i = 0; i < n_tasks; i++) {
+            threadpool_add_task(p, count_task, &count);
+          }
+          threadpool_wait(p);
+          ASSERT_EQ(__atomic_load_n(&count, __ATOMIC_ACQUIRE), round * n_tasks);
+          // Laisser les travailleurs s'endormir avant le lot suivant
+          usleep(2000);
+        }
+
+        int tree_count = 0;
+        threadpool_add_task(p, tree_task, new tree_arg{p, depth, &tree_count});
+        threadpool_join(p);
+        EXPECT_EQ(tree_count, (1 << (depth + 1)) - 1)
+            << "queue=" << queue << " stealing=" << stealing
+            << " spin=" << spin;
+      }
+    }
+  }
+}
+
+static void* sleep_task(void* arg) {
+  usleep(20000);
+  return count_task(arg);
+}
+
+/*
+ * Pool élastique: des tâches longues qui s'accumulent font démarrer des
+ * travailleurs jusqu'à max_threads; une fois le pool au repos, les travailleurs
+ * ajoutés se retirent et il n'en reste que nb_threads. Le pool doit ensuite
+ * pouvoir grandir à nouveau, et threadpool_join() attendre toutes les tâches.
+ */
+TEST(ThreadPool, Elastic) {
+  const int n_tasks = 16;
+
+  for (auto idle : {THREADPOOL_IDLE_BLOCK, THREADPOOL_IDLE_SPIN}) {
+    struct pool_attr attr;
+    threadpool_attr_init(&attr, 1);
+    attr.max_threads = 4;
+    attr.idle_timeout_ms = 20;
+    attr.idle = idle;
+    struct pool* p = threadpool_create_attr(&attr);
+    ASSERT_TRUE(p != nullptr);
+    EXPECT_EQ(threadpool_nb_workers(p), 1);
+
+    int count = 0;
+    for (int round = 1; round <= 2; round++) {
+      for (int i = 0; i < n_tasks; i++) {
+        threadpool_add_task(p, sleep_task, &count);
+      }
+      EXPECT_EQ(threadpool_nb_workers(p), 4) << "idle=" << idle;
+      threadpool_wait(p);
+      EXPECT_EQ(__atomic_load_n(&count, __ATOMIC_ACQUIRE), round * n_tasks);
+
+      for (int i = 0; i < 100 && threadpool_nb_workers(p) > 1; i++) {
+        usleep(10000);
+      }
+      EXPECT_EQ(threadpool_nb_workers(p), 1) << "idle=" << idle;
+    }
+
+    for (int i = 0; i < n_tasks; i++) {
+      threadpool_add_task(p, sleep_task, &count);
+    }
+    threadpool_join(p);
+    EXPECT_EQ(count, 3 * n_tasks);
+  }
+}
+
+struct quad_arg {
+  struct pool* pool;
+  int depth;
+  long sum;
+};
+
+// Découper en quatre quadrants et attendre leurs sommes depuis la tâche
+static void* quad_task(void* arg) {
+  struct quad_arg* q = static_cast<struct quad_arg*>(arg);
+  if (q->depth == 0) {
+    q->sum = 1;
+    return NULL;
+  }
+  struct quad_arg children[4];
+  struct taskgroup group;
+  taskgroup_init(&group, q->pool);
+  for (auto& child : children) {
+    child = {q->pool, q->depth - 1, 0};
+    taskgroup_run(&group, quad_task, &child);
+  }
+  taskgroup_wait(&group);
+  q->sum = 0;
+  for (auto& child : children) {
+    q->sum += child.sum;
+  }
+  return NULL;
+}
+
+/*
+ * Fork-join imbriqué: chaque tâche attend ses quatre sous-tâches. Avec deux
+ * travailleurs et des milliers de tâches en attente sur la pile, le pool ne
+ * doit pas s'interbloquer, quelle que soit la file ou le vol de tâches. Le
+ * thread principal attend lui aussi un groupe.
+ */
+TEST(ThreadPool, TaskGroupNested) {
+  const int depth = 5;
+
+  for (auto queue : {THREADPOOL_QUEUE_LIST, THREADPOOL_QUEUE_RING}) {
+    for (int stealing = 0; stealing <= 1; stealing++) {
+      struct pool_attr attr;
+      threadpool_attr_init(&attr, 2);
+      attr.work_stealing = stealing;
+      attr.queue = queue;
+      attr.ring_capacity = 16;
+      struct pool* p = threadpool_create_attr(&attr);
+      ASSERT_TRUE(p != nullptr);
+
+      struct quad_arg roots[3];
+      struct taskgroup group;
+      taskgroup_init(&group, p);
+      for (auto& root : roots) {
+        root = {p, depth, 0};
+        taskgroup_run(&group, quad_task, &root);
+      }
+      taskgroup_wait(&group);
+
+      for (auto& root : roots) {
+        EXPECT_EQ(root.sum, 1 << (2 * depth))
+            << "queue=" << queue << " stealing=" << stealing;
+      }
+      threadpool_join(p);
+    }
+  }
+}
+
+static int bounded_gate;
+
+static void* bounded_gate_task(void* arg) {
+  while (!__atomic_load_n(&bounded_gate, __ATOMIC_ACQUIRE)) {
+    sched_yield();
+  }
+  return count_task(arg);
+}
+
+struct bounded_producer {
+  struct pool* pool;
+  int* count;
+  int submitted;
+};
+
+static void* bounded_producer_main(void* arg) {
+  struct bounded_producer* bp = static_cast<struct bounded_producer*>(arg);
+  threadpool_add_task(bp->pool, count_task, bp->count);
+  __atomic_store_n(&bp->submitted, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+/*
+ * Pool borné à quatre tâches en cours: la cinquième soumission reçoit EAGAIN
+ * de threadpool_try_add_task() et bloque dans threadpool_add_task() jusqu'à ce
+ * qu'une tâche se termine.
+ */
+TEST(ThreadPool, BoundedSubmit) {
+  for (auto queue : {THREADPOOL_QUEUE_LIST, THREADPOOL_QUEUE_RING}) {
+    struct pool_attr attr;
+    threadpool_attr_init(&attr, 1);
+    attr.queue = queue;
+    attr.max_pending = 4;
+    struct pool* p = threadpool_create_attr(&attr);
+    ASSERT_TRUE(p != nullptr);
+
+    int count = 0;
+    __atomic_store_n(&bounded_gate, 0, __ATOMIC_RELEASE);
+    for (int i = 0; i < 4; i++) {
+      EXPECT_EQ(threadpool_try_add_task(p, bounded_gate_task, &count), 0);
+    }
+    EXPECT_EQ(threadpool_try_add_task(p, count_task, &count), EAGAIN);
+
+    struct bounded_producer bp = {p, &count, 0};
+    pthread_t producer;
+    ASSERT_EQ(pthread_create(&producer, NULL, bounded_producer_main, &bp), 0);
+    usleep(20000);
+    EXPECT_EQ(__atomic_load_n(&bp.submitted, __ATOMIC_ACQUIRE), 0);
+
+    __atomic_store_n(&bounded_gate, 1, __ATOMIC_RELEASE);
+    pthread_join(producer, NULL);
+    EXPECT_EQ(bp.submitted, 1);
+    threadpool_join(p);
+    EXPECT_EQ(count, 5) << "queue=" << queue;
+  }
+}
+
+/*
+ * Compteurs par travailleur: la somme des travailleurs et des tâches exécutées
+ * par le thread principal (taskgroup_wait) donne le total, et chaque
+ * histogramme compte toutes les tâches. Des tâches de 20 ms placent la médiane
+ * d'exécution dans la case [2^24, 2^25) ns.
+ */
+TEST(ThreadPool, Stats) {
+  const int n_tasks = 200;
+  struct pool_attr attr;
+  threadpool_attr_init(&attr, 3);
+  attr.stats = 1;
+  struct pool* p = threadpool_create_attr(&attr);
+  ASSERT_TRUE(p != nullptr);
+
+  int count = 0;
+  struct taskgroup group;
+  taskgroup_init(&group, p);
+  for (int i = 0; i < n_tasks; i++) {
+    taskgroup_run(&group, count_task, &count);
+  }
+  taskgroup_wait(&group);
+  threadpool_wait(p);
+
+  struct threadpool_stats total;
+  threadpool_get_stats(p, -1, &total);
+  EXPECT_EQ(total.nb_tasks, (uint64_t)n_tasks);
+  uint64_t sum = 0;
+  for (int i = 0; i < 3; i++) {
+    struct threadpool_stats s;
+    threadpool_get_stats(p, i, &s);
+    sum += s.nb_tasks;
+  }
+  EXPECT_EQ(sum + p->extern_stats.nb_tasks, total.nb_tasks);
+  uint64_t waits = 0;
+  uint64_t execs = 0;
+  for (int i = 0; i < THREADPOOL_HIST_BUCKETS; i++) {
+    waits += total.wait_hist[i];
+    execs += total.exec_hist[i];
+  }
+  EXPECT_EQ(waits, total.nb_tasks);
+  EXPECT_EQ(execs, total.nb_tasks);
+  EXPECT_LE(threadpool_hist_percentile(total.wait_hist, 0.5),
+            threadpool_hist_percentile(total.wait_hist, 0.99));
+
+  for (int i = 0; i < 6; i++) {
+    threadpool_add_task(p, sleep_task, &count);
+  }
+  threadpool_wait(p);
+  struct threadpool_stats after;
+  threadpool_get_stats(p, -1, &after);
+  EXPECT_EQ(after.nb_tasks, (uint64_t)n_tasks + 6);
+  EXPECT_GE(after.busy_ns, 6 * 20000000ull);
+  // Les travailleurs prennent les tâches de la file partagée sous le verrou
+  EXPECT_GE(after.lock_acquires, 6u);
+  uint64_t slow[THREADPOOL_HIST_BUCKETS];
+  for (int i = 0; i < THREADPOOL_HIST_BUCKETS; i++) {
+    slow[i] = after.exec_hist[i] - total.exec_hist[i];
+  }
+  EXPECT_EQ(threadpool_hist_percentile(slow, 0.5), 1ull << 25);
+
+  threadpool_join(p);
+  EXPECT_EQ(count, n_tasks + 6);
+}
+
+TEST(ThreadPool, TopologyParseList) {
+  int ids[16];
+  const int expected[] = {0, 1, 2, 3, 8, 10, 11};
+  ASSERT_EQ(topology_parse_list("0-3,8,10-11\n", ids, 16), 7);
+  for (int i = 0; i < 7; i++) {
+    EXPECT_EQ(ids[i], expected[i]);
+  }
+  EXPECT_EQ(topology_parse_list("0-3,8", ids, 2), 2);
+  EXPECT_EQ(topology_parse_list("\n", ids, 16), 0);
+  EXPECT_EQ(topology_parse_list("3-1", ids, 16), -1);
+  EXPECT_EQ(topology_parse_list("0,x", ids, 16), -1);
+}
+
+static void* pinned_task(void* arg) {
+  cpu_set_t set;
+  pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+  if (CPU_COUNT(&set) != 1) {
+    __atomic_add_fetch(static_cast<int*>(arg), 1, __ATOMIC_RELAXED);
+  }
+  return NULL;
+}
+
+/*
+ * Avec THREADPOOL_AFFINITY_NUMA, chaque travailleur est épinglé sur un seul
+ * processeur utilisable, et les processeurs sont groupés par noeud.
+ */
+TEST(ThreadPool, AffinityNuma) {
+  struct topology topo;
+  ASSERT_EQ(topology_init(&topo), 0);
+  cpu_set_t allowed;
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+  EXPECT_EQ(topo.nb_cpus, CPU_COUNT(&allowed));
+  EXPECT_GE(topo.nb_nodes, 1);
+  EXPECT_EQ(topo.node_first[0], 0);
+  EXPECT_EQ(topo.node_first[topo.nb_nodes], topo.nb_cpus);
+  for (int node = 0; node < topo.nb_nodes; node++) {
+    for (int i = topo.node_first[node]; i < topo.node_first[node + 1]; i++) {
+      EXPECT_TRUE(CPU_ISSET(topo.cpus[i], &allowed));
+      EXPECT_EQ(topology_cpu_node(&topo, topo.cpus[i]), node);
+    }
+  }
+  topology_destroy(&topo);
+
+  for (int stealing = 0; stealing <= 1; stealing++) {
+    int unpinned = 0;
+    struct pool_attr attr;
+    threadpool_attr_init(&attr, 4);
+    attr.affinity = THREADPOOL_AFFINITY_NUMA;
+    attr.work_stealing = stealing;
+    std::unique_ptr<struct pool, threadpool_deleter> p(
+        threadpool_create_attr(&attr));
+    ASSERT_TRUE(p.get() != nullptr);
+
+    for (int i = 0; i < 100; i++) {
+      threadpool_add_task(p.get(), pinned_task, &unpinned);
+    }
+    threadpool_wait(p.get());
+    EXPECT_EQ(unpinned, 0);
+  }
+}
+
 #include "processing.h"
 #include "threadpool.h"
 
@@ -129,3 +827,186 @@ TEST(ThreadPool, Processing) {
   list_free(work_list);
   ASSERT_TRUE(are_files_identical(img_serial, img_multithread));
 }
+
+/*
+ * Un même pool traite plusieurs lots d'images de suite.
+ */
+TEST(ThreadPool, ProcessingReusedPool) {
+  const char* outputs[] = {BINARY_DIR "/test/cat-reused-0.png",
+                           BINARY_DIR "/test/cat-reused-1.png"};
+  struct list* work_list = list_new(NULL, free_work_item);
+  struct work_item* item
+      = (struct work_item*)calloc(1, sizeof(struct work_item));
+
+  item->input_file = strdup(img);
+  list_push_back(work_list, list_node_new(item));
+
+  std::unique_ptr<struct pool, threadpool_deleter> p(threadpool_create(2));
+  ASSERT_TRUE(p.get() != nullptr);
+  for (const char* output : outputs) {
+    free(item->output_file);
+    item->output_file = strdup(output);
+    EXPECT_EQ(process_on_pool(work_list, p.get()), 0);
+  }
+
+  list_free(work_list);
+  ASSERT_TRUE(are_files_identical(outputs[0], outputs[1]));
+}
+
+/*
+ * Une sortie qui ne peut pas être écrite fait échouer le lot, en séquentiel,
+ * sur le pool et avec la compression répartie.
+ */
+TEST(ThreadPool, ProcessingWriteFailure) {
+  // Une petite image, pour que le test reste court
+  const char* small = BINARY_DIR "/test/small.png";
+  image_t* src = image_create(0, 32, 32);
+  ASSERT_TRUE(src != nullptr);
+  ASSERT_EQ(image_save_png(src, small), 0);
+  image_destroy(src);
+
+  struct list* work_list = list_new(NULL, free_work_item);
+  struct work_item* item
+      = (struct work_item*)calloc(1, sizeof(struct work_item));
+  item->input_file = strdup(small);
+  item->output_file = strdup(BINARY_DIR "/test/missing-dir/cat.png");
+  list_push_back(work_list, list_node_new(item));
+
+  EXPECT_EQ(process_serial(work_list), -1);
+  EXPECT_EQ(process_multithread(work_list, 2), -1);
+
+  struct process_opts opts;
+  process_opts_init(&opts);
+  opts.split = PROCESS_SPLIT_ALWAYS;
+  opts.parallel_encode = 1;
+  EXPECT_EQ(process_multithread_opts(work_list, 2, &opts), -1);
+
+  list_free(work_list);
+  remove(small);
+}
+
+/*
+ * Avec un budget mémoire, les images qu'un pool borné plein refuse sont
+ * traitées par le thread qui soumet, et le budget reste cohérent.
+ */
+TEST(ThreadPool, ProcessingBudgetBoundedPool) {
+  const char* small = BINARY_DIR "/test/small-bounded.png";
+  image_t* src = image_create(0, 32, 32);
+  ASSERT_TRUE(src != nullptr);
+  ASSERT_EQ(image_save_png(src, small), 0);
+  image_destroy(src);
+
+  const int nb_items = 6;
+  std::vector<std::string> outputs;
+  struct list* work_list = list_new(NULL, free_work_item);
+  for (int i = 0; i < nb_items; i++) {
+    outputs.push_back(BINARY_DIR "/test/small-bounded-" + std::to_string(i) +
+                      ".png");
+    struct work_item* item
+        = (struct work_item*)calloc(1, sizeof(struct work_item));
+    item->input_file = strdup(small);
+    item->output_file = strdup(outputs.back().c_str());
+    list_push_back(work_list, list_node_new(item));
+  }
+
+  struct pool_attr attr;
+  threadpool_attr_init(&attr, 1);
+  attr.max_pending = 1;
+  std::unique_ptr<struct pool, threadpool_deleter> p(
+      threadpool_create_attr(&attr));
+  ASSERT_TRUE(p.get() != nullptr);
+
+  struct process_opts opts;
+  process_opts_init(&opts);
+  opts.memory_budget = 1 << 30;
+  EXPECT_EQ(process_on_pool_opts(work_list, p.get(), &opts), 0);
+  list_free(work_list);
+
+  for (const std::string& output : outputs) {
+    EXPECT_TRUE(are_files_identical(outputs[0], output));
+  }
+  for (const std::string& output : outputs) {
+    remove(output.c_str());
+  }
+  remove(small);
+}
+
+/*
+ * Les coûts sont lus dans l'en-tête PNG et le tri par coût décroissant
+ * conserve l'ordre des éléments de même coût.
+ */
+TEST(ThreadPool, ProcessingCostOrder) {
+  const char* inputs[] = {SOURCE_DIR "/test/cat.jpg", img, img, img};
+  struct list* work_list = list_new(NULL, free_work_item);
+  struct work_item* items[4];
+  for (int i = 0; i < 4; i++) {
+    items[i] = (struct work_item*)calloc(1, sizeof(struct work_item));
+    items[i]->input_file = strdup(inputs[i]);
+    list_push_back(work_list, list_node_new(items[i]));
+  }
+  items[3]->cost = 1000000;
+
+  // cat.jpg n'est pas un PNG: son coût reste inconnu
+  EXPECT_EQ(process_estimate_costs(work_list), -1);
+  EXPECT_EQ(items[0]->cost, 0u);
+  EXPECT_EQ(items[1]->cost, 768u * 512u);
+  EXPECT_EQ(items[3]->cost, 1000000u);
+
+  EXPECT_EQ(process_sort_by_cost(work_list), 0);
+  struct work_item* expected[] = {items[3], items[1], items[2], items[0]};
+  struct list_node* node = list_head(work_list);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(node->data, expected[i]);
+    node = node->next;
+  }
+
+  list_free(work_list);
+}
+
+/*
+ * Avec un budget mémoire plus petit que deux images, les images sont traitées
+ * une à la fois et produisent le même résultat. Le pool a déjà traité un lot:
+ * les tampons gardés dans les caches de ses travailleurs comptent aussi dans
+ * le budget.
+ */
+TEST(ThreadPool, ProcessingMemoryBudget) {
+  const char* outputs[] = {BINARY_DIR "/test/cat-budget-0.png",
+                           BINARY_DIR "/test/cat-budget-1.png"};
+  struct list* work_list = list_new(NULL, free_work_item);
+  for (const char* output : outputs) {
+    struct work_item* item
+        = (struct work_item*)calloc(1, sizeof(struct work_item));
+    item->input_file = strdup(img);
+    item->output_file = strdup(output);
+    list_push_back(work_list, list_node_new(item));
+  }
+
+  struct work_item* first = (struct work_item*)list_head(work_list)->data;
+  EXPECT_EQ(process_estimate_costs(work_list), 0);
+  EXPECT_EQ(process_footprint(first),
+            768u * 512u * PROCESS_BYTES_PER_PIXEL);
+
+  std::unique_ptr<struct pool, threadpool_deleter> p(threadpool_create(2));
+  ASSERT_TRUE(p.get() != nullptr);
+  struct process_opts opts;
+  process_opts_init(&opts);
+  opts.memory_budget = process_footprint(first);
+
+  // Un premier lot sans budget remplit les caches des travailleurs
+  struct list* warmup = list_new(NULL, NULL);
+  list_push_back(warmup, list_node_new(first));
+  EXPECT_EQ(process_on_pool(warmup, p.get()), 0);
+  list_free(warmup);
+  struct bufpool_stats stats;
+  bufpool_get_stats(&stats);
+  EXPECT_GT(stats.cached_bytes, opts.memory_budget);
+
+  EXPECT_EQ(process_on_pool_opts(work_list, p.get(), &opts), 0);
+  list_free(work_list);
+
+  // Les tampons gardés en réserve tiennent aussi dans le budget
+  bufpool_get_stats(&stats);
+  EXPECT_LE(stats.cached_bytes, opts.memory_budget);
+
+  ASSERT_TRUE(are_files_identical(outputs[0], outputs[1]));
+}
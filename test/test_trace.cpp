@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "threadpool.h"
+#include "trace.h"
+
+static void* nap_task(void* arg) {
+  usleep(2000);
+  return arg;
+}
+
+static std::string read_all(FILE* f) {
+  std::string s;
+  char buf[4096];
+  rewind(f);
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    s.append(buf, n);
+  }
+  return s;
+}
+
+static size_t count(const std::string& s, const std::string& what) {
+  size_t n = 0;
+  for (size_t pos = s.find(what); pos != std::string::npos;
+       pos = s.find(what, pos + 1)) {
+    n++;
+  }
+  return n;
+}
+
+/*
+ * Série « temps actif »: au plus deux threads actifs avec deux travailleurs,
+ * des temps croissants et un retour à zéro. Chaque tâche donne un début et une
+ * fin dans la trace JSON; rien n'est enregistré après l'arrêt.
+ */
+TEST(Trace, ActiveThreadsAndJson) {
+  const int n_tasks = 20;
+  struct pool* pool = threadpool_create(2);
+  ASSERT_TRUE(pool != nullptr);
+
+  trace_start();
+  for (int i = 0; i < n_tasks; i++) {
+    threadpool_add_task(pool, nap_task, NULL);
+  }
+  threadpool_wait(pool);
+  trace_stop();
+  threadpool_add_task(pool, nap_task, NULL);
+  threadpool_join(pool);
+
+  FILE* active = tmpfile();
+  ASSERT_TRUE(active != nullptr);
+  ASSERT_EQ(trace_write_active(active), 0);
+  rewind(active);
+  char header[64];
+  ASSERT_TRUE(fgets(header, sizeof(header), active) != nullptr);
+  EXPECT_STREQ(header, "# temps actif\n");
+  double t;
+  double last_t = 0.0;
+  int nb;
+  int max_nb = 0;
+  int last_nb = -1;
+  int nb_lines = 0;
+  while (fscanf(active, "%lf %d", &t, &nb) == 2) {
+    EXPECT_GE(t, last_t);
+    EXPECT_GE(nb, 0);
+    EXPECT_LE(nb, 2);
+    max_nb = nb > max_nb ? nb : max_nb;
+    last_t = t;
+    last_nb = nb;
+    nb_lines++;
+  }
+  // Le zéro initial, puis un début et une fin par tâche
+  EXPECT_EQ(nb_lines, 1 + 2 * n_tasks);
+  EXPECT_GE(max_nb, 1);
+  EXPECT_EQ(last_nb, 0);
+  fclose(active);
+
+  FILE* json = tmpfile();
+  ASSERT_TRUE(json != nullptr);
+  ASSERT_EQ(trace_write_json(json), 0);
+  std::string s = read_all(json);
+  fclose(json);
+  EXPECT_EQ(s.rfind("{\"traceEvents\":[", 0), 0u);
+  EXPECT_EQ(count(s, "\"ph\":\"B\""), (size_t)n_tasks);
+  EXPECT_EQ(count(s, "\"ph\":\"E\""), (size_t)n_tasks);
+  EXPECT_EQ(count(s, "\"name\":\"task\""), (size_t)(2 * n_tasks));
+}